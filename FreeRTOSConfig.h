@@ -99,6 +99,8 @@
 #define configUSE_TRACE_FACILITY	0
 #define configUSE_16_BIT_TICKS		0
 #define configIDLE_SHOULD_YIELD		1
+#define configUSE_MUTEXES			1
+#define configUSE_COUNTING_SEMAPHORES	1
 
 /* timer */
 #define configTIMER_TASK_PRIORITY 3
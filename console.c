@@ -6,10 +6,16 @@
 #include "task.h"
 #include "serial.h"
 #include "console.h"
+#include "i2ctrace.h"
+#include "controller.h"
+#include "sensors.h"
+#include "event.h"
+#include "log.h"
 
 #define consoleSTACK_SIZE			( ( unsigned portBASE_TYPE ) 256 )
 #define consoleBUFFER_LEN			( ( unsigned portBASE_TYPE ) 256 )
 #define consoleMAX_DELAY			( ( portTickType ) 1000 )
+#define consoleLINE_LEN				( ( unsigned portBASE_TYPE ) 32 )
 
 /* Handle to the com port used by the console. */
 static xComPortHandle xPort;
@@ -20,6 +26,63 @@ static void vConsoleTask( void *pvParameters );
 /* Console prompt */
 const signed char *pcPrompt = "Command> ";
 
+/* a console command: what to type, what it does */
+struct Command
+{
+	const char *name;
+	void (*run)(void);
+	const char *help;
+};
+
+static void printHelp(void);
+
+static const struct Command commands[] =
+{
+	{ "help", printHelp, "list commands" },
+	{ "i2c", vI2CTracePrintHistograms, "I2C bus time histograms per device" },
+	{ "trace", vI2CTracePrintRing, "recent I2C transactions" },
+	{ "latency", vControllerPrintLatency, "sample to lights latency per event" },
+	{ "batch", vControllerPrintBatches, "events per batch and light writes" },
+	{ "poll", vSensorsPrintPollStats, "sensor polls, edges and bus use per poll mode" },
+	{ "doors", vPrintDoors, "published door states" },
+	{ "events", vPrintEvents, "event counters and recent events" },
+	{ "log", vPrintLog, "controller log ring counters" }
+};
+
+#define consoleNUM_COMMANDS			( sizeof(commands) / sizeof(commands[0]) )
+
+static void printHelp(void)
+{
+	unsigned int i;
+
+	for(i=0;i<consoleNUM_COMMANDS;++i)
+	{
+		printf("%-8s %s\r\n", commands[i].name, commands[i].help);
+	}
+}
+
+/* Run the command typed on one line, ignoring empty lines */
+static void runCommand(const char *line)
+{
+	unsigned int i;
+
+	if (line[0] == '\0')
+	{
+		return;
+	}
+
+	for(i=0;i<consoleNUM_COMMANDS;++i)
+	{
+		if (strcmp(line, commands[i].name) == 0)
+		{
+			commands[i].run();
+			return;
+		}
+	}
+
+	printf("unknown command, try help\r\n");
+}
+
 void vStartConsole( unsigned portBASE_TYPE uxPriority, unsigned long ulBaudRate)
 {
 	/* Initialise the com port. */
@@ -39,6 +102,8 @@ xComPortHandle xConsolePortHandle(void)
 static portTASK_FUNCTION( vConsoleTask, pvParameters )
 {
 	signed char cRxChar;
+	char line[consoleLINE_LEN];
+	unsigned portBASE_TYPE length;
 
 	/* Just to stop compiler warnings. */
 	( void ) pvParameters;
@@ -49,6 +114,7 @@ static portTASK_FUNCTION( vConsoleTask, pvParameters )
 		vSerialPutString(xPort, pcPrompt, strlen((const char *)pcPrompt));
 
 		cRxChar = 0;
+		length = 0;
 
 		while (cRxChar != '\r')
 		{
@@ -62,6 +128,13 @@ static portTASK_FUNCTION( vConsoleTask, pvParameters )
 			{
 				xSerialPutChar(xPort, '\n', consoleMAX_DELAY);
 			}
+			else if (length < consoleLINE_LEN - 1)
+			{
+				line[length++] = (char) cRxChar;
+			}
 		}
+
+		line[length] = '\0';
+		runCommand(line);
 	}
 }
@@ -5,216 +5,305 @@
 #include "queue.h"
 #include "lpc24xx.h"
 #include "controller.h"
+#include "event.h"
+#include "statemachine.h"
+#include "persist.h"
+#include "log.h"
 #include "sensors.h"
+#include "pca9532.h"
 #include "mytimer.h"
 #include "lcd_hw.h"
+#include "staticassert.h"
 
 #define controllerSTACK_SIZE			( ( unsigned portBASE_TYPE ) 256 )
 
-const int NUMBER_OF_STATES = 5;
-const int NUMBER_OF_TRANSITIONS = 8;
+const portTickType TICKS_TO_WAIT = 10;
 
-const ulong OUTDOOR_LOCK_INDOOR_LOCK = 0L;
-const ulong OUTDOOR_UNLOCK_INDOOR_LOCK = 1L;
-const ulong OUTDOOR_OPEN_INDOOR_LOCK = 2L;
-const ulong OUTDOOR_LOCK_INDOOR_UNLOCK = 3L;
-const ulong OUTDOOR_LOCK_INDOOR_OPEN = 4L;
+/* how an unlocked door's light blinks */
+#define UNLOCKED_BLINK_MS				500
+#define UNLOCKED_BLINK_DUTY				50
 
-const ulong PASSWORD_APPROVED = 0L;
-const ulong OUTDOOR_BTN_PRESSED = 1L;
-const ulong FIVE_SECONDS_PASSED = 2L;
-const ulong OUTDOOR_OPEN = 3L;
-const ulong OUTDOOR_CLOSE = 4L;
-const ulong INDOOR_BTN_PRESSED = 5L;
-const ulong INDOOR_OPEN = 6L;
-const ulong INDOOR_CLOSE = 7L;
+/* where one airlock's door lights are: an expander (index into the
+ * sensors expander table) and an LED (0-15) on it for each door */
+struct AirlockConfig
+{
+	int expander;
+	int outerLed;
+	int innerLed;
+};
 
-const portTickType TICKS_TO_WAIT = 10;
+/* one row per airlock */
+static const struct AirlockConfig airlockConfig[] =
+{
+	{ 0, 8, 10 }		/* LS2 index 0 and 2 */
+};
 
-extern xQueueHandle xGlobalStateQueueQ;
+/* one row per airlock, or this does not compile */
+STATIC_ASSERT(sizeof(airlockConfig) / sizeof(airlockConfig[0]) == NUMBER_OF_AIRLOCKS, airlockConfigHasEveryAirlock);
 
-static ulong globalState = OUTDOOR_LOCK_INDOOR_LOCK;
-static unsigned char lightState;
+/* sample to lights latency, indexed by event type */
+static struct LatencyStats latencyStats[NUMBER_OF_TRANSITIONS];
 
-ulong (*stateMachine[5][8])(ulong, ulong);
+/* events in this batch that switched a light, timed when the lights are
+ * flushed */
+static struct Event lit[CONTROLLER_BATCH_LENGTH];
+static int litCount;
 
-static void vControllerTask(void *pvParameters);
+static struct BatchStats batchStats;
 
-static ulong outdoorBtnPressed(ulong current_state, ulong state_transition)
+/* the state other tasks read.  sequence is odd while the controller is
+ * writing published, and only the controller writes either */
+static volatile struct ControllerState published;
+static volatile unsigned long sequence;
+
+static StateListener listeners[CONTROLLER_MAX_LISTENERS];
+static int listenerCount;
+
+static const char *eventNames[NUMBER_OF_TRANSITIONS] =
 {
-	printf("outer door unlock, inner door lock\r\n");
-	printf("index 0 light off\r\n");	
-	lightState &= setLightOff(0);	
-	putLights(lightState);
+	"password", "outer button", "timeout", "outer open",
+	"outer close", "inner button", "inner open", "inner close",
+	"held open"
+};
 
-	startTimer();
-   	
-	printf("\r\n");
-	return OUTDOOR_UNLOCK_INDOOR_LOCK;
-}
+static void vControllerTask(void *pvParameters);
 
-static ulong outdoorFiveSecondsPassed(ulong current_state, ulong state_transition)
+static void recordLatency(ulong type, unsigned long latency)
 {
-	printf("outer door lock, inner door lock\r\n");
-	printf("index 0 light on\r\n");
-	lightState |= setLightOn(0);
-	putLights( lightState );
+	struct LatencyStats *stats = &latencyStats[type];
+	unsigned long limit;
+	int bin;
 
-	printf("\r\n");
-	return OUTDOOR_LOCK_INDOOR_LOCK;
+	vTaskSuspendAll();
+	if(stats->count == 0 || latency < stats->min)
+	{
+		stats->min = latency;
+	}
+	if(latency > stats->max)
+	{
+		stats->max = latency;
+	}
+	stats->count++;
+	stats->total += latency;
+
+	limit = LATENCY_FIRST_BIN_US;
+	for(bin=0; bin<LATENCY_BINS-1 && latency>=limit; ++bin)
+	{
+		limit <<= 1;
+	}
+	stats->bins[bin]++;
+	xTaskResumeAll();
 }
 
-static ulong outdoorPasswordApproved(ulong current_state, ulong state_transition)
+/* send the lights switched since the last flush, one burst per expander,
+ * and time every event that switched one */
+static void flushOutputs(void)
 {
-	printf("outer door unlock, inner door lock\r\n");
-	printf("index 0 light off\r\n");
-	lightState &= setLightOff(0);
-	putLights(lightState);
+	unsigned long now;
+	int i;
+
+	if(litCount == 0)
+	{
+		return;
+	}
 
-	startTimer();
+	flushLights();
+	now = ulTimestampUs();
+	for(i=0;i<litCount;++i)
+	{
+		recordLatency(lit[i].type, now - lit[i].timestamp);
+	}
+	litCount = 0;
 
-	printf("\r\n");
-	return OUTDOOR_UNLOCK_INDOOR_LOCK;
+	vTaskSuspendAll();
+	batchStats.flushes++;
+	xTaskResumeAll();
 }
 
-static ulong outdoorOpen(ulong current_state, ulong state_transition)
+/* a locked door's light is on, an unlocked one's blinks */
+static enum LightMode doorLightMode(int locked)
 {
-	printf("outer door open, inner door lock\r\n");
-	stopTimer();
-	
-	printf("\r\n");
-	return OUTDOOR_OPEN_INDOOR_LOCK;
+	return locked ? LIGHT_ON : LIGHT_BLINK;
 }
 
-static ulong outdoorClose(ulong current_state, ulong state_transition)
+/* switch one of an airlock's door lights for the state machine.  Nothing
+ * goes on the bus until the batch is done, see flushOutputs() */
+void setDoorLight(const struct Event *cause, ulong airlock, enum Door door, int on)
 {
-	printf("outer door close(lock), inner door lock\r\n");
-	printf("index 0 light on\r\n");
-	lightState |= setLightOn(0);
-	putLights( lightState );
+	const struct AirlockConfig *config = &airlockConfig[airlock];
+	int led = (door == OUTER_DOOR) ? config->outerLed : config->innerLed;
 
-	printf("\r\n");
-	return OUTDOOR_LOCK_INDOOR_LOCK;
-}
+	logWrite(on ? "airlock %lu light %lu on" : "airlock %lu light %lu blinking", airlock, (unsigned long) led);
+	setLight(config->expander, led, doorLightMode(on));
 
-static ulong indoorBtnPressed(ulong current_state, ulong state_transition)
-{
-	printf("outer door lock, inner door unlock\r\n");
-	printf("index 2 light off\r\n");
-	lightState &= setLightOff(2);
-	putLights(lightState);
-	startTimer();
-	
-	printf("\r\n");
-	return OUTDOOR_LOCK_INDOOR_UNLOCK;
+	/* replayed events can make a batch longer than the queue */
+	if(litCount == CONTROLLER_BATCH_LENGTH)
+	{
+		flushOutputs();
+	}
+	lit[litCount++] = *cause;
+
+	vTaskSuspendAll();
+	batchStats.lightChanges++;
+	xTaskResumeAll();
 }
 
-static ulong indoorFiveSecondsPassed(ulong current_state, ulong state_transition)
+void vControllerGetLatency(ulong type, struct LatencyStats *stats)
 {
-	printf("outer door lock, inner door lock\r\n");
-	printf("index 2 light on\r\n");
-	lightState |= setLightOn(2);
-	putLights( lightState );
-
-	printf("\r\n");
-	return OUTDOOR_LOCK_INDOOR_LOCK;
+	vTaskSuspendAll();
+	*stats = latencyStats[type];
+	xTaskResumeAll();
 }
 
-static ulong indoorOpen(ulong current_state, ulong state_transition)
+unsigned long latencyPercentile(const struct LatencyStats *stats, unsigned int percent)
 {
-	printf("outer door lock, inner door open\r\n");
+	unsigned long needed;
+	unsigned long seen = 0;
+	unsigned long limit = LATENCY_FIRST_BIN_US;
+	int bin;
 
-	stopTimer();
+	if(stats->count == 0)
+	{
+		return 0;
+	}
 
-	printf("\r\n");
-	return OUTDOOR_LOCK_INDOOR_OPEN;
+	/* samples at or below the percentile, rounded up */
+	needed = (stats->count * percent + 99) / 100;
+	for(bin=0; bin<LATENCY_BINS-1; ++bin)
+	{
+		seen += stats->bins[bin];
+		if(seen >= needed)
+		{
+			break;
+		}
+		limit <<= 1;
+	}
+
+	/* the last bucket is open ended, so use the worst seen */
+	return (bin == LATENCY_BINS-1) ? stats->max : limit;
 }
 
-static ulong indoorClose(ulong current_state, ulong state_transition)
+void vControllerGetBatchStats(struct BatchStats *stats)
 {
-	printf("outer door lock, inner door close(lock)\r\n");
-	printf("index 2 light on\r\n");
-	lightState |= setLightOn(2);
-	putLights( lightState );
-	printf("\r\n");
-	return OUTDOOR_LOCK_INDOOR_LOCK;
+	vTaskSuspendAll();
+	*stats = batchStats;
+	xTaskResumeAll();
 }
 
-static ulong waitingState(ulong current_state, ulong state_transition)
+void vControllerPrintBatches(void)
 {
-	// push the state_transition back to the tail of the queque
-	xQueueSendToBack(xGlobalStateQueueQ, &state_transition, 10);
+	struct BatchStats stats;
+	xPCA9532Stats expander;
 
-	// delay 10 milliseconds
-   	vTaskDelay(10/portTICK_RATE_MS);
+	vControllerGetBatchStats(&stats);
+	vPCA9532GetStats(&expander);
 
-	// printf("\r\n");
-   	// does not change the current state
-	return current_state;
+	printf("batches %lu, events %lu, largest %lu\r\n", stats.batches, stats.events, stats.largest);
+	printf("light changes %lu, flushes %lu, expander write bursts %lu\r\n",
+		stats.lightChanges, stats.flushes, expander.ulTransactions);
 }
 
-static ulong emptyState(ulong current_state, ulong state_transition)
+void vControllerPrintLatency(void)
 {
-	// do nothing
-	printf("The action was rejected by the state matchine\r\n");
+	struct LatencyStats stats;
+	ulong type;
 
-	printf("\r\n");
-	return current_state;
+	printf("sample to lights latency (us)\r\n");
+	printf("event           count      min      avg      p99      max\r\n");
+	for(type=0; type<(ulong) NUMBER_OF_TRANSITIONS; ++type)
+	{
+		vControllerGetLatency(type, &stats);
+		if(stats.count == 0)
+		{
+			continue;
+		}
+		printf("%-12s %8lu %8lu %8lu %8lu %8lu\r\n", eventNames[type], stats.count,
+			stats.min, stats.total / stats.count, latencyPercentile(&stats, 99), stats.max);
+	}
 }
 
-
-inline void sendToGlobalQueue(ulong state)
+/* publish the airlocks' states if they changed, keep them for a warm
+ * restart and tell the listeners */
+static void publishState(void)
 {
-	xQueueSend(xGlobalStateQueueQ, &state, TICKS_TO_WAIT);
-	printf("message: %d send to queue\r\n", state);
-}
-
+	struct ControllerState next;
+	ulong airlock;
+	int changed = 0;
+	int i;
 
-
-void initializeStateMachine()
-{
-	int i, j;
-	for(i=0;i<NUMBER_OF_STATES;++i)
+	for(airlock=0;airlock<NUMBER_OF_AIRLOCKS;++airlock)
 	{
-		for(j=0;j<NUMBER_OF_TRANSITIONS;++j)
+		next.state[airlock] = (unsigned char) airlockState(airlock);
+		next.unlocked[airlock] = (unsigned char) unlockedDoors(airlock);
+		if(published.state[airlock] != next.state[airlock] ||
+			published.unlocked[airlock] != next.unlocked[airlock])
 		{
-			stateMachine[i][j] = emptyState;
+			changed = 1;
 		}
 	}
+	if(!changed)
+	{
+		return;
+	}
+	next.version = published.version + 1;
 
-	// normal state transitions
-	stateMachine[OUTDOOR_LOCK_INDOOR_LOCK][PASSWORD_APPROVED] = outdoorPasswordApproved;
-	stateMachine[OUTDOOR_LOCK_INDOOR_LOCK][OUTDOOR_BTN_PRESSED] = outdoorBtnPressed;
-	stateMachine[OUTDOOR_LOCK_INDOOR_LOCK][INDOOR_BTN_PRESSED] = indoorBtnPressed;
+	sequence++;
+	published = next;
+	sequence++;
 
-	stateMachine[OUTDOOR_UNLOCK_INDOOR_LOCK][FIVE_SECONDS_PASSED] = outdoorFiveSecondsPassed;
-	stateMachine[OUTDOOR_UNLOCK_INDOOR_LOCK][OUTDOOR_OPEN] = outdoorOpen;
+	savePersistedState(&next);
 
-	stateMachine[OUTDOOR_OPEN_INDOOR_LOCK][OUTDOOR_CLOSE] = outdoorClose;
+	for(i=0;i<listenerCount;++i)
+	{
+		listeners[i](next.version);
+	}
+}
 
-	stateMachine[OUTDOOR_LOCK_INDOOR_UNLOCK][FIVE_SECONDS_PASSED] = indoorFiveSecondsPassed;
-	stateMachine[OUTDOOR_LOCK_INDOOR_UNLOCK][INDOOR_OPEN] = indoorOpen;
+void getControllerState(struct ControllerState *state)
+{
+	unsigned long before;
 
-	stateMachine[OUTDOOR_LOCK_INDOOR_OPEN][INDOOR_CLOSE] = indoorClose;
-	
-	// waiting transitions
-	/* For example: if the inner door unclock and outer door button press,
-	 * My implementation will wait until the inner door lock and then unlock the outer door
-	 */
-	stateMachine[OUTDOOR_LOCK_INDOOR_UNLOCK][OUTDOOR_BTN_PRESSED] = waitingState;
-	stateMachine[OUTDOOR_LOCK_INDOOR_OPEN][OUTDOOR_BTN_PRESSED] = waitingState;
+	/* the controller runs above every reader, so it is never preempted
+	 * mid publish by one and this goes round at most once per publish */
+	do
+	{
+		before = sequence;
+		*state = published;
+	} while((before & 1) || sequence != before);
+}
 
-	stateMachine[OUTDOOR_LOCK_INDOOR_UNLOCK][PASSWORD_APPROVED] = waitingState;
-	stateMachine[OUTDOOR_LOCK_INDOOR_OPEN][PASSWORD_APPROVED] = waitingState;
+portBASE_TYPE addControllerListener(StateListener listener)
+{
+	portBASE_TYPE added = pdFALSE;
 
-	stateMachine[OUTDOOR_UNLOCK_INDOOR_LOCK][INDOOR_BTN_PRESSED] = waitingState;
-	stateMachine[OUTDOOR_OPEN_INDOOR_LOCK][INDOOR_BTN_PRESSED] = waitingState;
+	portENTER_CRITICAL();
+	if(listenerCount < CONTROLLER_MAX_LISTENERS)
+	{
+		listeners[listenerCount++] = listener;
+		added = pdTRUE;
+	}
+	portEXIT_CRITICAL();
+
+	return added;
 }
 
+void vPrintDoors(void)
+{
+	struct ControllerState state;
+	ulong airlock;
+
+	getControllerState(&state);
+	printf("version %lu, held open alarms %lu\r\n", state.version, doorAlarms());
+	for(airlock=0;airlock<NUMBER_OF_AIRLOCKS;++airlock)
+	{
+		printf("airlock %lu: outer %s, inner %s\r\n", airlock,
+			doorStatus(state.state[airlock], state.unlocked[airlock], OUTER_DOOR),
+			doorStatus(state.state[airlock], state.unlocked[airlock], INNER_DOOR));
+	}
+}
 
 void vStartController( unsigned portBASE_TYPE uxPriority )
 {
-	initializeStateMachine();
 	xTaskCreate( vControllerTask, ( signed char * )"Controller", controllerSTACK_SIZE, NULL, uxPriority, ( xTaskHandle * ) NULL);
 
 	printf("Controller task started ...\r\n");
@@ -222,21 +311,84 @@ void vStartController( unsigned portBASE_TYPE uxPriority )
 
 static portTASK_FUNCTION(vControllerTask, pvParameters)
 {
-	ulong stateTransition;
-	printf("initial state: outer door lock, inner door lock\r\n");
-	lightState = 0;
-	lightState |= setLightOn(0);
-	lightState |= setLightOn(2);
-	printf("index 0 light on\r\n");
-	printf("index 2 light on\r\n");
-	putLights( lightState );
+	struct Event event;
+	struct ControllerState saved;
+	ulong airlock;
+	ulong count;
+	unsigned int unlocked;
+
+	/* after a watchdog or reset pin restart carry on where the last
+	 * transition left off, otherwise start with everything locked */
+	initStateMachine();
+	if(restorePersistedState(&saved))
+	{
+		for(airlock=0;airlock<NUMBER_OF_AIRLOCKS;++airlock)
+		{
+			if(restoreAirlock(airlock, saved.state[airlock], saved.unlocked[airlock]))
+			{
+				logWrite("airlock %lu: warm restart in state %lu", airlock, airlockState(airlock));
+			}
+			else
+			{
+				logWrite("airlock %lu: saved state %lu not valid, starting locked", airlock, saved.state[airlock]);
+			}
+		}
+		published.version = saved.version;
+	}
+	else
+	{
+		logWrite("cold start, reset cause %lx: outer doors lock, inner doors lock", lastResetCause(), 0);
+	}
+
+	for(airlock=0;airlock<NUMBER_OF_AIRLOCKS;++airlock)
+	{
+		unlocked = unlockedDoors(airlock);
+		setBlinkRate(airlockConfig[airlock].expander, UNLOCKED_BLINK_MS, UNLOCKED_BLINK_DUTY);
+		setLight(airlockConfig[airlock].expander, airlockConfig[airlock].outerLed, doorLightMode(!(unlocked & DOOR_BIT(OUTER_DOOR))));
+		setLight(airlockConfig[airlock].expander, airlockConfig[airlock].innerLed, doorLightMode(!(unlocked & DOOR_BIT(INNER_DOOR))));
+	}
+	flushLights();
+	publishState();
+
 	while(1)
 	{
-		/* if receive sth */
-		if( xQueueReceive( xGlobalStateQueueQ, &stateTransition, portMAX_DELAY) == pdTRUE )
+		/* sleep until an event arrives */
+		if( receiveEvent(&event, portMAX_DELAY) != pdTRUE )
 		{
-			/* call the state transition function, update the globalState(current_state) */
-			globalState = stateMachine[globalState][stateTransition](globalState, stateTransition);
-		}		
+			continue;
+		}
+
+		/* then handle everything already waiting, up to a batch, before
+		 * touching the outputs, so a burst costs one write per expander */
+		count = 0;
+		do
+		{
+			/* a deadline that fired as its state was left is not news */
+			if(event.source == SOURCE_TIMER &&
+				!deadlineCurrent(event.airlock, event.type, event.timestamp))
+			{
+				logWrite("airlock %lu: stale deadline event %lu dropped", event.airlock, event.type);
+			}
+			else if(handleEvent(&event))
+			{
+				replayDeferred(event.airlock);
+			}
+			++count;
+		} while(count < CONTROLLER_BATCH_LENGTH && receiveEvent(&event, 0) == pdTRUE);
+
+		flushOutputs();
+		publishState();
+
+		vTaskSuspendAll();
+		batchStats.batches++;
+		batchStats.events += count;
+		if(count > batchStats.largest)
+		{
+			batchStats.largest = count;
+		}
+		xTaskResumeAll();
+
+		/* keep the sensors polling fast while a door is unlocked */
+		vSensorsSetActive(unlockedAirlocks() != 0);
 	}
 }
@@ -5,4 +5,104 @@ void vStartController( unsigned portBASE_TYPE uxPriority );
 
 typedef unsigned long ulong;
 
+/* controller states */
+enum State
+{
+	OUTDOOR_LOCK_INDOOR_LOCK,
+	OUTDOOR_UNLOCK_INDOOR_LOCK,
+	OUTDOOR_OPEN_INDOOR_LOCK,
+	OUTDOOR_LOCK_INDOOR_UNLOCK,
+	OUTDOOR_LOCK_INDOOR_OPEN,
+	NUMBER_OF_STATES
+};
+
+/* event types, the columns of the transition table */
+enum EventType
+{
+	PASSWORD_APPROVED,
+	OUTDOOR_BTN_PRESSED,
+	FIVE_SECONDS_PASSED,
+	OUTDOOR_OPEN,
+	OUTDOOR_CLOSE,
+	INDOOR_BTN_PRESSED,
+	INDOOR_OPEN,
+	INDOOR_CLOSE,
+	DOOR_HELD_OPEN,
+	NUMBER_OF_TRANSITIONS
+};
+
+/* not an event, for tables where an event is optional */
+#define NO_EVENT				NUMBER_OF_TRANSITIONS
+
+/* independent airlocks (pairs of doors) run by the controller, one row
+ * each in airlockConfig in controller.c */
+#define NUMBER_OF_AIRLOCKS		1
+
+/* most events the controller handles before it writes the lights */
+#define CONTROLLER_BATCH_LENGTH	16
+
+/* how well the controller batches its light writes */
+struct BatchStats
+{
+	unsigned long batches;		/* wake-ups, each handling at least one event */
+	unsigned long events;
+	unsigned long largest;		/* most events in one batch */
+	unsigned long lightChanges;	/* lights switched, each a bus write if not batched */
+	unsigned long flushes;		/* batches that switched a light */
+};
+
+/* log2 buckets of sample to lights latency; bucket 0 is under
+ * LATENCY_FIRST_BIN_US and each one after covers twice the time */
+#define LATENCY_BINS			16
+#define LATENCY_FIRST_BIN_US	16UL
+
+/* sample to lights latency for one event type, in microseconds */
+struct LatencyStats
+{
+	unsigned long count;
+	unsigned long min;
+	unsigned long max;
+	unsigned long total;
+	unsigned long bins[LATENCY_BINS];
+};
+
+void vControllerGetLatency(ulong type, struct LatencyStats *stats);
+
+/* upper bound of the bucket holding the given percentile, 0 if no samples */
+unsigned long latencyPercentile(const struct LatencyStats *stats, unsigned int percent);
+
+/* print min/avg/p99 for every event type to the console */
+void vControllerPrintLatency(void);
+
+void vControllerGetBatchStats(struct BatchStats *stats);
+
+/* print the batch counters next to the expander write bursts sent */
+void vControllerPrintBatches(void);
+
+/* what other tasks can see of the controller, published after each batch
+ * of events that changed something */
+struct ControllerState
+{
+	unsigned long version;						/* counts changes */
+	unsigned char state[NUMBER_OF_AIRLOCKS];	/* enum State */
+	unsigned char unlocked[NUMBER_OF_AIRLOCKS];	/* DOOR_BIT()s, see statemachine.h */
+};
+
+/* listeners the controller can call */
+#define CONTROLLER_MAX_LISTENERS	2
+
+/* called from the controller task with the new version after every
+ * change, so it must not block: give a semaphore or post to a queue */
+typedef void (*StateListener)(unsigned long version);
+
+/* copy the latest published state.  Never waits for the controller: if it
+ * was halfway through publishing, the copy is simply taken again */
+void getControllerState(struct ControllerState *state);
+
+/* returns pdFALSE if CONTROLLER_MAX_LISTENERS are already added */
+portBASE_TYPE addControllerListener(StateListener listener);
+
+/* print every airlock's published state to the console */
+void vPrintDoors(void);
+
 #endif
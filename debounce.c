@@ -0,0 +1,68 @@
+/*
+	Bit-parallel input debouncer using vertical counters.
+*/
+
+#include "FreeRTOS.h"
+
+#include "debounce.h"
+
+/*-----------------------------------------------------------*/
+
+void vDebounceInit( xDebouncer *pxDebouncer, unsigned portBASE_TYPE uxSamples, unsigned long ulInitial )
+{
+	if( uxSamples < 1 )
+	{
+		uxSamples = 1;
+	}
+	if( uxSamples > debounceMAX_SAMPLES )
+	{
+		uxSamples = debounceMAX_SAMPLES;
+	}
+
+	pxDebouncer->ulState = ulInitial;
+	pxDebouncer->ulCount0 = 0;
+	pxDebouncer->ulCount1 = 0;
+	pxDebouncer->ulCount2 = 0;
+
+	/* Spread the sample count across the planes so the comparison in
+	ulDebounce() is three XORs. */
+	pxDebouncer->ulMatch0 = ( uxSamples & 1 ) ? ~0UL : 0UL;
+	pxDebouncer->ulMatch1 = ( uxSamples & 2 ) ? ~0UL : 0UL;
+	pxDebouncer->ulMatch2 = ( uxSamples & 4 ) ? ~0UL : 0UL;
+}
+/*-----------------------------------------------------------*/
+
+unsigned long ulDebounce( xDebouncer *pxDebouncer, unsigned long ulSample )
+{
+unsigned long ulDelta, ulToggle;
+unsigned long ulC0 = pxDebouncer->ulCount0;
+unsigned long ulC1 = pxDebouncer->ulCount1;
+unsigned long ulC2 = pxDebouncer->ulCount2;
+
+	/* Inputs that disagree with their debounced state count up; every
+	other counter is cleared. */
+	ulDelta = ulSample ^ pxDebouncer->ulState;
+	ulC2 = ( ulC2 ^ ( ulC1 & ulC0 ) ) & ulDelta;
+	ulC1 = ( ulC1 ^ ulC0 ) & ulDelta;
+	ulC0 = ~ulC0 & ulDelta;
+
+	/* Inputs whose counter has reached the sample count change state. */
+	ulToggle = ulDelta
+			 & ~( ulC0 ^ pxDebouncer->ulMatch0 )
+			 & ~( ulC1 ^ pxDebouncer->ulMatch1 )
+			 & ~( ulC2 ^ pxDebouncer->ulMatch2 );
+
+	pxDebouncer->ulState ^= ulToggle;
+	pxDebouncer->ulCount0 = ulC0 & ~ulToggle;
+	pxDebouncer->ulCount1 = ulC1 & ~ulToggle;
+	pxDebouncer->ulCount2 = ulC2 & ~ulToggle;
+
+	return pxDebouncer->ulState;
+}
+/*-----------------------------------------------------------*/
+
+portBASE_TYPE xDebounceBusy( const xDebouncer *pxDebouncer )
+{
+	return ( pxDebouncer->ulCount0 | pxDebouncer->ulCount1 | pxDebouncer->ulCount2 ) ? pdTRUE : pdFALSE;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,41 @@
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include "FreeRTOS.h"
+
+/* Largest sample count the 3-bit vertical counters can hold */
+#define debounceMAX_SAMPLES		7
+
+/*
+ * Debounces up to 32 inputs at once.  Each input has a 3-bit counter held
+ * "vertically": bit n of ulCount0..ulCount2 is the counter for input n, so
+ * one pass of a few word-wide logic operations updates every input.
+ */
+typedef struct DEBOUNCER
+{
+	unsigned long ulState;			/* debounced inputs */
+	unsigned long ulCount0;			/* counter bit planes */
+	unsigned long ulCount1;
+	unsigned long ulCount2;
+	unsigned long ulMatch0;			/* sample count, one plane per bit */
+	unsigned long ulMatch1;
+	unsigned long ulMatch2;
+} xDebouncer;
+
+/*
+ * An input only changes state once uxSamples consecutive samples
+ * (1 to debounceMAX_SAMPLES) have disagreed with its current state.
+ */
+void vDebounceInit( xDebouncer *pxDebouncer, unsigned portBASE_TYPE uxSamples, unsigned long ulInitial );
+
+/*
+ * Feed one raw sample of every input and return the debounced state.
+ */
+unsigned long ulDebounce( xDebouncer *pxDebouncer, unsigned long ulSample );
+
+/*
+ * pdTRUE while any input is part way through a change.
+ */
+portBASE_TYPE xDebounceBusy( const xDebouncer *pxDebouncer );
+
+#endif
@@ -0,0 +1,249 @@
+/* The controller's event queues.  Every event is a fixed 8 byte record, so
+ * the queues are sized in events, and each carries enough (source, sequence
+ * number, sample time) to be checked and traced on its own.
+ *
+ * Events go into one of three lanes by type, so a burst of button presses
+ * can never fill the queue a door sensor event needs.  The controller
+ * serves the lanes highest first; a counting semaphore, given once per
+ * queued event, lets it sleep on all three at once. */
+#include <stdio.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "controller.h"
+#include "event.h"
+#include "staticassert.h"
+
+/* an event record bigger than two words (8 bytes here) does not compile */
+STATIC_ASSERT(sizeof(struct Event) == 2 * sizeof(unsigned long), eventIsTwoWords);
+
+extern const portTickType TICKS_TO_WAIT;
+
+static xQueueHandle lanes[NUMBER_OF_LANES];
+
+/* counts events waiting in all the lanes */
+static xSemaphoreHandle doorbell;
+
+/* held by a task sending for a source, so a sequence number is only used
+ * up once its event is in the lane */
+static xSemaphoreHandle senders[NUMBER_OF_SOURCES];
+
+static const unsigned portBASE_TYPE laneLength[NUMBER_OF_LANES] =
+{
+	SAFETY_LANE_LENGTH, TIMER_LANE_LENGTH, USER_LANE_LENGTH
+};
+
+/* the lane for each event type */
+static const unsigned char laneOf[NUMBER_OF_TRANSITIONS] =
+{
+	LANE_USER,		/* PASSWORD_APPROVED */
+	LANE_USER,		/* OUTDOOR_BTN_PRESSED */
+	LANE_TIMER,		/* FIVE_SECONDS_PASSED */
+	LANE_SAFETY,	/* OUTDOOR_OPEN */
+	LANE_SAFETY,	/* OUTDOOR_CLOSE */
+	LANE_USER,		/* INDOOR_BTN_PRESSED */
+	LANE_SAFETY,	/* INDOOR_OPEN */
+	LANE_SAFETY,	/* INDOOR_CLOSE */
+	LANE_TIMER		/* DOOR_HELD_OPEN */
+};
+
+/* next sequence number per lane and source, and the last one received.
+ * A lane keeps one source's events in order, but lanes overtake each
+ * other, so the numbers only count up within a lane */
+static unsigned char nextSeq[NUMBER_OF_LANES][NUMBER_OF_SOURCES];
+static unsigned char lastSeq[NUMBER_OF_LANES][NUMBER_OF_SOURCES];
+static portBASE_TYPE seen[NUMBER_OF_LANES][NUMBER_OF_SOURCES];
+
+static struct EventStats eventStats[NUMBER_OF_SOURCES];
+static struct LaneStats laneStats[NUMBER_OF_LANES];
+
+/* last events received, oldest overwritten first */
+static struct Event trace[EVENT_TRACE_LENGTH];
+static unsigned long traced;
+
+static const char *sourceNames[NUMBER_OF_SOURCES] =
+{
+	"sensors", "timer", "keypad", "console"
+};
+
+static const char *laneNames[NUMBER_OF_LANES] =
+{
+	"safety", "timer", "user"
+};
+
+void vCreateEventQueue(void)
+{
+	int lane;
+	int source;
+
+	for(lane=0; lane<NUMBER_OF_LANES; ++lane)
+	{
+		lanes[lane] = xQueueCreate(laneLength[lane], sizeof(struct Event));
+	}
+	for(source=0; source<NUMBER_OF_SOURCES; ++source)
+	{
+		senders[source] = xSemaphoreCreateMutex();
+	}
+	doorbell = xSemaphoreCreateCounting(SAFETY_LANE_LENGTH + TIMER_LANE_LENGTH + USER_LANE_LENGTH, 0);
+}
+
+portBASE_TYPE sendEvent(enum EventType type, enum EventSource source, ulong airlock, unsigned long timestamp)
+{
+	struct Event event;
+	portBASE_TYPE sent;
+	unsigned long depth;
+	int lane;
+
+	if(type >= NUMBER_OF_TRANSITIONS)
+	{
+		return pdFALSE;
+	}
+	lane = laneOf[type];
+
+	event.type = (unsigned char) type;
+	event.source = (unsigned char) source;
+	event.airlock = (unsigned char) airlock;
+	event.timestamp = timestamp;
+
+	/* a source may send from more than one task.  A dropped event keeps
+	 * its number for the next one, so a drop is counted once, as dropped,
+	 * and never again as lost */
+	xSemaphoreTake(senders[source], portMAX_DELAY);
+	event.seq = nextSeq[lane][source];
+	sent = xQueueSend(lanes[lane], &event, TICKS_TO_WAIT);
+	if(sent == pdTRUE)
+	{
+		nextSeq[lane][source]++;
+		/* the event is in its lane before the controller hears of it */
+		xSemaphoreGive(doorbell);
+	}
+	xSemaphoreGive(senders[source]);
+
+	depth = uxQueueMessagesWaiting(lanes[lane]);
+
+	portENTER_CRITICAL();
+	if(sent == pdTRUE)
+	{
+		eventStats[source].sent++;
+	}
+	else
+	{
+		eventStats[source].dropped++;
+		laneStats[lane].overflows++;
+	}
+	if(depth > laneStats[lane].deepest)
+	{
+		laneStats[lane].deepest = depth;
+	}
+	portEXIT_CRITICAL();
+
+	return sent;
+}
+
+portBASE_TYPE receiveEvent(struct Event *event, portTickType wait)
+{
+	struct EventStats *stats;
+	int lane;
+
+	while(xSemaphoreTake(doorbell, wait) == pdTRUE)
+	{
+		/* each ring of the doorbell follows an event into some lane, and
+		 * only this task takes them out, so one is always there */
+		for(lane=0; lane<NUMBER_OF_LANES; ++lane)
+		{
+			if(xQueueReceive(lanes[lane], event, 0) == pdTRUE)
+			{
+				break;
+			}
+		}
+		if(lane == NUMBER_OF_LANES || event->source >= NUMBER_OF_SOURCES)
+		{
+			continue;
+		}
+		stats = &eventStats[event->source];
+
+		portENTER_CRITICAL();
+		if(seen[lane][event->source] && event->seq == lastSeq[lane][event->source])
+		{
+			stats->duplicates++;
+			portEXIT_CRITICAL();
+			continue;
+		}
+		if(seen[lane][event->source])
+		{
+			/* sequence numbers skipped since the last one */
+			stats->lost += (unsigned char) (event->seq - lastSeq[lane][event->source] - 1);
+		}
+		seen[lane][event->source] = pdTRUE;
+		lastSeq[lane][event->source] = event->seq;
+		stats->received++;
+
+		trace[traced % EVENT_TRACE_LENGTH] = *event;
+		traced++;
+		portEXIT_CRITICAL();
+
+		return pdTRUE;
+	}
+
+	return pdFALSE;
+}
+
+void getEventStats(enum EventSource source, struct EventStats *stats)
+{
+	portENTER_CRITICAL();
+	*stats = eventStats[source];
+	portEXIT_CRITICAL();
+}
+
+void getLaneStats(enum EventLane lane, struct LaneStats *stats)
+{
+	unsigned long depth = uxQueueMessagesWaiting(lanes[lane]);
+
+	portENTER_CRITICAL();
+	*stats = laneStats[lane];
+	portEXIT_CRITICAL();
+	stats->depth = depth;
+}
+
+void vPrintEvents(void)
+{
+	struct EventStats stats;
+	struct LaneStats lane;
+	struct Event copy[EVENT_TRACE_LENGTH];
+	unsigned long count, first, i;
+	int source;
+
+	printf("source       sent  dropped received     dups     lost\r\n");
+	for(source=0; source<NUMBER_OF_SOURCES; ++source)
+	{
+		getEventStats((enum EventSource) source, &stats);
+		printf("%-8s %8lu %8lu %8lu %8lu %8lu\r\n", sourceNames[source],
+			stats.sent, stats.dropped, stats.received, stats.duplicates, stats.lost);
+	}
+
+	printf("\r\nlane     length    depth  deepest overflow\r\n");
+	for(i=0; i<(unsigned long) NUMBER_OF_LANES; ++i)
+	{
+		getLaneStats((enum EventLane) i, &lane);
+		printf("%-8s %6lu %8lu %8lu %8lu\r\n", laneNames[i], (unsigned long) laneLength[i],
+			lane.depth, lane.deepest, lane.overflows);
+	}
+
+	portENTER_CRITICAL();
+	count = (traced < EVENT_TRACE_LENGTH) ? traced : EVENT_TRACE_LENGTH;
+	first = traced - count;
+	for(i=0; i<count; ++i)
+	{
+		copy[i] = trace[(first + i) % EVENT_TRACE_LENGTH];
+	}
+	portEXIT_CRITICAL();
+
+	printf("\r\n  sampled(us) source   seq airlock type\r\n");
+	for(i=0; i<count; ++i)
+	{
+		printf("%13lu %-8s %3u %7u %4u\r\n", copy[i].timestamp,
+			(copy[i].source < NUMBER_OF_SOURCES) ? sourceNames[copy[i].source] : "?",
+			(unsigned) copy[i].seq, (unsigned) copy[i].airlock, (unsigned) copy[i].type);
+	}
+}
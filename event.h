@@ -0,0 +1,79 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include "controller.h"
+
+/* who sent an event */
+enum EventSource
+{
+	SOURCE_SENSORS,
+	SOURCE_TIMER,
+	SOURCE_KEYPAD,
+	SOURCE_CONSOLE,
+	NUMBER_OF_SOURCES
+};
+
+/* the controller's queues, served highest first: door sensors, then
+ * timers, then user requests (password, buttons) */
+enum EventLane
+{
+	LANE_SAFETY,
+	LANE_TIMER,
+	LANE_USER,
+	NUMBER_OF_LANES
+};
+
+/* one record on a controller queue, 8 bytes */
+struct Event
+{
+	unsigned char type;			/* enum EventType */
+	unsigned char source;		/* enum EventSource */
+	unsigned char airlock;		/* the door pair it is for */
+	unsigned char seq;			/* counts up per lane and source, wrapping */
+	unsigned long timestamp;	/* ulTimestampUs() when the input was sampled */
+};
+
+/* events each lane can hold */
+#define SAFETY_LANE_LENGTH		8
+#define TIMER_LANE_LENGTH		(2 * NUMBER_OF_AIRLOCKS)
+#define USER_LANE_LENGTH		8
+
+/* received events kept for the console */
+#define EVENT_TRACE_LENGTH		16
+
+/* per source event counters */
+struct EventStats
+{
+	unsigned long sent;
+	unsigned long dropped;		/* lane stayed full */
+	unsigned long received;
+	unsigned long duplicates;	/* same sequence number twice in a row, ignored */
+	unsigned long lost;			/* gaps in the sequence numbers; drops leave none */
+};
+
+/* per lane counters */
+struct LaneStats
+{
+	unsigned long depth;		/* events waiting now */
+	unsigned long deepest;		/* most events ever waiting */
+	unsigned long overflows;	/* events dropped because the lane stayed full */
+};
+
+void vCreateEventQueue(void);
+
+/* stamp an event with its lane's next sequence number for the source and
+ * queue it for the controller, waiting up to TICKS_TO_WAIT for room.  The
+ * number is only used up if the event is queued */
+portBASE_TYPE sendEvent(enum EventType type, enum EventSource source, ulong airlock, unsigned long timestamp);
+
+/* wait for the next event from the highest lane that has one, skipping
+ * duplicates */
+portBASE_TYPE receiveEvent(struct Event *event, portTickType wait);
+
+void getEventStats(enum EventSource source, struct EventStats *stats);
+void getLaneStats(enum EventLane lane, struct LaneStats *stats);
+
+/* print the counters and the last few events received to the console */
+void vPrintEvents(void);
+
+#endif
@@ -0,0 +1,30 @@
+/* Host build: just enough of FreeRTOS.h for the board independent modules
+ * to compile on a PC.  Types match the ARM7 port; rtos.c implements the
+ * API in queue.h, semphr.h, task.h and timers.h for a single thread. */
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#include <stddef.h>
+
+#define portBASE_TYPE			long
+#define portCHAR				char
+#define portTickType			unsigned long
+#define portMAX_DELAY			( portTickType ) 0xffffffff
+#define portTICK_RATE_MS		( ( portTickType ) 1 )
+
+#define pdTRUE					( 1 )
+#define pdFALSE					( 0 )
+#define pdPASS					( 1 )
+#define pdFAIL					( 0 )
+#define errQUEUE_EMPTY			( 0 )
+#define errQUEUE_FULL			( 0 )
+
+/* One thread and simulated interrupts that only run when it blocks, so
+ * there is nothing to lock out */
+#define portENTER_CRITICAL()
+#define portEXIT_CRITICAL()
+#define portEXIT_SWITCHING_ISR( xSwitchRequired )	( void ) ( xSwitchRequired )
+
+#define portTASK_FUNCTION( vFunction, pvParameters )	void vFunction( void *pvParameters )
+
+#endif
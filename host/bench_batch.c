@@ -0,0 +1,113 @@
+/* Host benchmark of the controller's light batching.  Replays an event
+ * trace through statemachine.c twice, with the door lights on a simulated
+ * PCA9532 as airlockConfig has them: first flushing the lights after every
+ * transition, then once per batch of events the way the controller task
+ * does.  Prints the write bursts and bus time each takes.
+ *
+ *   bench_batch [-w trace file] [trace file] */
+#include <stdio.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "controller.h"
+#include "statemachine.h"
+#include "pca9532.h"
+#include "i2csim.h"
+#include "stubs.h"
+#include "trace.h"
+
+#define SESSIONS				2000
+
+#define OUTER_LED				8
+#define INNER_LED				10
+
+static struct SimPCA9532 device;
+static xPCA9532 expander;
+
+/* lights go to the shadow registers only, and an unlocked door's light
+ * blinks, as setDoorLight() does */
+static void setLed(ulong airlock, enum Door door, int on)
+{
+	(void) airlock;
+	vPCA9532SetLed(&expander, (door == OUTER_DOOR) ? OUTER_LED : INNER_LED, on ? pcaLED_ON : pcaLED_PWM0);
+}
+
+static void flush(void)
+{
+	vPCA9532Flush(&expander);
+	simRunUntilIdle();
+}
+
+static void run(const char *name, void (*afterTransition)(void), void (*afterBatch)(void))
+{
+	struct ReplayStats replay;
+	struct SimBusStats bus;
+	xPCA9532Stats before, after;
+
+	vPCA9532GetStats(&before);
+	simClearStats(i2cBUS0);
+	replayTrace(afterTransition, afterBatch, &replay);
+	flush();
+	vPCA9532GetStats(&after);
+	simGetStats(i2cBUS0, &bus);
+
+	printf("batch: %-20s %6lu transitions %6lu batches %6lu write bursts %6lu bytes %8.1f ms on the bus\n",
+		name, replay.transitions, replay.batches, after.ulTransactions - before.ulTransactions,
+		bus.bytes, bus.busyUs / 1000.0);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *out = NULL, *in = NULL;
+	unsigned long e, batched = 0, length = 1;
+	int i;
+
+	for(i=1;i<argc;++i)
+	{
+		if(strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+		{
+			out = argv[++i];
+		}
+		else
+		{
+			in = argv[i];
+		}
+	}
+	if(in != NULL)
+	{
+		readTrace(in);
+	}
+	else
+	{
+		generateTrace(SESSIONS);
+	}
+	if(out != NULL)
+	{
+		writeTrace(out);
+	}
+
+	/* events that share their poll with another */
+	for(e=1;e<traceLength;++e)
+	{
+		if(trace[e].ms == trace[e - 1].ms)
+		{
+			batched += (length == 1) ? 2 : 1;
+			length++;
+		}
+		else
+		{
+			length = 1;
+		}
+	}
+	printf("batch: %lu events, %lu of them arriving with another\n", traceLength, batched);
+
+	simPCA9532(&device, pcaADDRESS);
+	simAttach(i2cBUS0, &device.device);
+	vPCA9532Init(&expander, i2cBUS0, pcaADDRESS, pdFALSE);
+	simRunUntilIdle();
+	stubLightHook = setLed;
+
+	run("flush per transition", flush, NULL);
+	run("flush per batch", NULL, flush);
+	return 0;
+}
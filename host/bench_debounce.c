@@ -0,0 +1,366 @@
+/* Host benchmark for the vertical counter debouncer.  Replays a bounce
+ * trace of 16 inputs, one raw sample word per millisecond, through
+ * debounce.c at several poll periods and sample counts, and reports the
+ * events each setting would raise that the contacts did not make, the
+ * changes it misses and how late it reports them.  Sample count 1 is the
+ * same as no debouncing.  Finally it times ulDebounce() per sample.
+ *
+ * The trace is generated, or read from a file of hex words, one per line,
+ * '#' starting a comment.  An input's true level is the level of the first
+ * run of at least SETTLE_MS equal samples not over by then, so a bounce
+ * counts as part of the change it ends in and a short spike as noise.
+ * The window is the shortest a new level must hold to be reported,
+ * (samples - 1) poll periods.
+ *
+ *   bench_debounce [-w trace-out] [trace-in] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "FreeRTOS.h"
+#include "debounce.h"
+
+#define INPUTS					16
+#define TRACE_MS				600000UL	/* generated trace, 10 minutes */
+#define SETTLE_MS				20
+
+/* generated contacts: time between changes, bounce after each change,
+ * and one noise spike per this many input milliseconds */
+#define HOLD_MIN_MS				150
+#define HOLD_MAX_MS				2000
+#define BOUNCE_MAX_MS			12
+#define SPIKE_EVERY_MS			20000
+
+#define TIMING_PASSES			20
+
+static unsigned short *raw;
+static unsigned short *truth;
+static unsigned long traceLength;
+
+static unsigned long random32(unsigned long *seed)
+{
+	/* xorshift32, so runs repeat across C libraries */
+	unsigned long x = *seed & 0xFFFFFFFFUL;
+
+	x ^= (x << 13) & 0xFFFFFFFFUL;
+	x ^= x >> 17;
+	x ^= (x << 5) & 0xFFFFFFFFUL;
+	*seed = x;
+	return x;
+}
+
+static void allocate(unsigned long length)
+{
+	traceLength = length;
+	raw = calloc(length, sizeof(raw[0]));
+	truth = calloc(length, sizeof(truth[0]));
+	if(raw == NULL || truth == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		exit(2);
+	}
+}
+
+static void generateTrace(void)
+{
+	unsigned long seed = 12345;
+	unsigned long t, end;
+	int input, level;
+
+	allocate(TRACE_MS);
+	for(input=0;input<INPUTS;++input)
+	{
+		level = 0;
+		t = 0;
+		while(t < traceLength)
+		{
+			/* bounce, then hold the new level */
+			end = t + random32(&seed) % (BOUNCE_MAX_MS + 1);
+			for(;t<end && t<traceLength;++t)
+			{
+				raw[t] |= (unsigned short) ((random32(&seed) & 1) << input);
+			}
+			end = t + HOLD_MIN_MS + random32(&seed) % (HOLD_MAX_MS - HOLD_MIN_MS);
+			for(;t<end && t<traceLength;++t)
+			{
+				raw[t] |= (unsigned short) (level << input);
+			}
+			level = !level;
+		}
+	}
+
+	/* one sample spikes: a contact that is not moving reads wrong */
+	for(t=0;t<traceLength*INPUTS/SPIKE_EVERY_MS;++t)
+	{
+		raw[random32(&seed) % traceLength] ^= (unsigned short) (1 << (random32(&seed) % INPUTS));
+	}
+}
+
+static void readTrace(const char *name)
+{
+	FILE *file = fopen(name, "r");
+	char line[80];
+	unsigned long length = 0, size = 0;
+
+	if(file == NULL)
+	{
+		perror(name);
+		exit(2);
+	}
+	while(fgets(line, sizeof(line), file) != NULL)
+	{
+		char *end;
+		unsigned long word;
+
+		if(line[0] == '#')
+		{
+			continue;
+		}
+		word = strtoul(line, &end, 16);
+		if(end == line)
+		{
+			continue;
+		}
+		if(length == size)
+		{
+			size = size ? size * 2 : 4096;
+			raw = realloc(raw, size * sizeof(raw[0]));
+			if(raw == NULL)
+			{
+				fprintf(stderr, "out of memory\n");
+				exit(2);
+			}
+		}
+		raw[length++] = (unsigned short) word;
+	}
+	fclose(file);
+
+	truth = calloc(length, sizeof(truth[0]));
+	if(truth == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		exit(2);
+	}
+	traceLength = length;
+}
+
+static void writeTrace(const char *name)
+{
+	FILE *file = fopen(name, "w");
+	unsigned long t;
+
+	if(file == NULL)
+	{
+		perror(name);
+		exit(2);
+	}
+	fprintf(file, "# %d inputs, one sample per millisecond\n", INPUTS);
+	for(t=0;t<traceLength;++t)
+	{
+		fprintf(file, "%04x\n", raw[t]);
+	}
+	fclose(file);
+}
+
+/* each sample takes the level of the first run of at least SETTLE_MS equal
+ * samples that has not ended by then, found working backwards */
+static void settleTrace(void)
+{
+	unsigned long t, start, end;
+	int input, level, settled;
+
+	for(input=0;input<INPUTS;++input)
+	{
+		settled = traceLength ? (raw[traceLength - 1] >> input) & 1 : 0;
+		for(end=traceLength;end>0;end=start)
+		{
+			level = (raw[end - 1] >> input) & 1;
+			for(start=end-1;start>0 && ((raw[start - 1] >> input) & 1) == level;--start)
+			{
+			}
+			if(end - start >= SETTLE_MS)
+			{
+				settled = level;
+			}
+			for(t=start;t<end;++t)
+			{
+				truth[t] |= (unsigned short) (settled << input);
+			}
+		}
+	}
+}
+
+struct Result
+{
+	unsigned long trueEdges;
+	unsigned long edges;		/* debounced edges reported */
+	unsigned long falseEdges;	/* to a level the contact did not settle at */
+	unsigned long missed;		/* true changes never reported */
+	unsigned long worstMs;		/* true change to the edge reporting it */
+};
+
+static void replay(unsigned long periodMs, unsigned int samples, struct Result *result)
+{
+	xDebouncer debouncer;
+	unsigned long t, changedAt[INPUTS];
+	unsigned short state, reported, pending = 0;
+	int input;
+
+	memset(result, 0, sizeof(*result));
+	memset(changedAt, 0, sizeof(changedAt));
+	vDebounceInit(&debouncer, samples, truth[0]);
+	reported = truth[0];
+
+	for(t=0;t<traceLength;++t)
+	{
+		unsigned short changed = (unsigned short) (t ? truth[t] ^ truth[t - 1] : 0);
+
+		/* a true change still pending when the level changes back was
+		 * never reported */
+		for(input=0;input<INPUTS;++input)
+		{
+			unsigned short bit = (unsigned short) (1 << input);
+
+			if(changed & bit)
+			{
+				result->trueEdges++;
+				if(pending & bit)
+				{
+					result->missed++;
+				}
+				pending ^= bit;
+				changedAt[input] = t;
+			}
+		}
+
+		if(t % periodMs != 0)
+		{
+			continue;
+		}
+		state = (unsigned short) ulDebounce(&debouncer, raw[t]);
+		changed = state ^ reported;
+		reported = state;
+		for(input=0;input<INPUTS;++input)
+		{
+			unsigned short bit = (unsigned short) (1 << input);
+
+			if(!(changed & bit))
+			{
+				continue;
+			}
+			result->edges++;
+			if((state ^ truth[t]) & bit)
+			{
+				result->falseEdges++;
+			}
+			else if(pending & bit)
+			{
+				pending &= (unsigned short) ~bit;
+				if(t - changedAt[input] > result->worstMs)
+				{
+					result->worstMs = t - changedAt[input];
+				}
+			}
+		}
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES			1
+#define readCycles()		__rdtsc()
+#else
+#define HAVE_CYCLES			0
+#define readCycles()		0
+#endif
+
+static void timeDebounce(void)
+{
+	xDebouncer debouncer;
+	volatile unsigned long sink = 0;
+	unsigned long long cycles;
+	unsigned long t;
+	int pass;
+	clock_t start;
+	double seconds, samples = (double) traceLength * TIMING_PASSES;
+
+	vDebounceInit(&debouncer, 3, 0);
+	start = clock();
+	cycles = readCycles();
+	for(pass=0;pass<TIMING_PASSES;++pass)
+	{
+		for(t=0;t<traceLength;++t)
+		{
+			sink ^= ulDebounce(&debouncer, raw[t]);
+		}
+	}
+	cycles = readCycles() - cycles;
+	seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+	printf("debounce: %.0f samples of %d inputs, %.2f ns per sample", samples, INPUTS, seconds * 1e9 / samples);
+	if(HAVE_CYCLES)
+	{
+		printf(", %.1f cycles per sample", (double) cycles / samples);
+	}
+	printf("\n");
+	(void) sink;
+}
+
+int main(int argc, char *argv[])
+{
+	static const unsigned long periods[] = { 5, 20, 80 };
+	const char *out = NULL, *in = NULL;
+	struct Result result;
+	unsigned int p, samples;
+	unsigned long rawFalse = 0;
+	int i;
+
+	for(i=1;i<argc;++i)
+	{
+		if(strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+		{
+			out = argv[++i];
+		}
+		else
+		{
+			in = argv[i];
+		}
+	}
+
+	if(in != NULL)
+	{
+		readTrace(in);
+	}
+	else
+	{
+		generateTrace();
+	}
+	if(out != NULL)
+	{
+		writeTrace(out);
+	}
+	settleTrace();
+
+	printf("debounce: %lu ms trace of %d inputs, settled after %d ms\n", traceLength, INPUTS, SETTLE_MS);
+	printf("debounce: poll ms  samples  window ms  true edges  edges  false  missed  worst ms\n");
+	for(p=0;p<sizeof(periods)/sizeof(periods[0]);++p)
+	{
+		for(samples=1;samples<=debounceMAX_SAMPLES;++samples)
+		{
+			replay(periods[p], samples, &result);
+			printf("debounce: %7lu  %7u  %9lu  %10lu  %5lu  %5lu  %6lu  %8lu\n",
+				periods[p], samples, (samples - 1) * periods[p],
+				result.trueEdges, result.edges, result.falseEdges, result.missed, result.worstMs);
+			if(p == 0 && samples == 1)
+			{
+				rawFalse = result.falseEdges;
+			}
+		}
+	}
+
+	timeDebounce();
+
+	/* undebounced polling of a bouncing trace must raise false events, or
+	 * the trace tests nothing */
+	return (in == NULL && rawFalse == 0) ? 1 : 0;
+}
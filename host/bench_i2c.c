@@ -0,0 +1,211 @@
+/* Host benchmark of the I2C transaction queue, on a simulated bus with a
+ * PCA9532 at 400 kHz.
+ *
+ * poll and lights: the sensor task's input read every 5 ms (client 0)
+ * while LED writes arrive at random, 2 ms apart on average (client 1), for
+ * how long each client is kept queued behind the other.  Poll latency is
+ * submit to completion, measured here; the queueing figures are the
+ * driver's own client statistics.
+ *
+ * flood: eight descriptors from four clients kept on the bus back to back,
+ * for the most transactions a second the driver and bus can do, in
+ * simulated time and in host time.
+ *
+ *   bench_i2c [simulated seconds] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "i2c.h"
+#include "pca9532.h"
+#include "rtos.h"
+#include "i2csim.h"
+
+#define MAX_CLIENTS				4
+#define FLOOD_DESCRIPTORS		8
+#define FLOOD_CLIENTS			MAX_CLIENTS
+
+#define POLL_PERIOD_US			5000UL
+#define LIGHTS_MEAN_US			2000UL
+#define CLIENT_POLL				0
+#define CLIENT_LIGHTS			1
+
+/* how often the simulated tasks look at their queues */
+#define STEP_US					5
+
+static struct SimPCA9532 device;
+static xPCA9532 expander;
+
+static unsigned long random32(unsigned long *seed)
+{
+	/* xorshift32, so runs repeat across C libraries */
+	unsigned long x = *seed & 0xFFFFFFFFUL;
+
+	x ^= (x << 13) & 0xFFFFFFFFUL;
+	x ^= x >> 17;
+	x ^= (x << 5) & 0xFFFFFFFFUL;
+	*seed = x;
+	return x;
+}
+
+/* client statistics since the last call, as there is no way to reset
+ * them.  The worst wait is since the program started */
+static void printClients(const char *name, unsigned portBASE_TYPE clients)
+{
+	static xI2CClientStats before[MAX_CLIENTS];
+	xI2CClientStats stats;
+	unsigned portBASE_TYPE client;
+	unsigned long transactions;
+
+	for(client=0;client<clients;++client)
+	{
+		vI2CGetClientStats(i2cBUS0, client, &stats);
+		transactions = stats.ulTransactions - before[client].ulTransactions;
+		printf("%s: client %lu: %lu transactions, %lu queued, wait %lu us total, worst %lu us\n",
+			name, (unsigned long) client, transactions,
+			stats.ulContended - before[client].ulContended,
+			stats.ulTotalWaitUs - before[client].ulTotalWaitUs, stats.ulWorstWaitUs);
+		before[client] = stats;
+	}
+}
+
+static void printBus(const char *name)
+{
+	static xI2CStats before;
+	xI2CStats stats;
+
+	vI2CGetStats(i2cBUS0, &stats);
+	printf("%s: %lu NACKs, %lu timeouts, %lu recoveries, worst latency %lu us, bus busy %lu us\n", name,
+		stats.ulNacks - before.ulNacks, stats.ulTimeouts - before.ulTimeouts,
+		stats.ulRecoveries - before.ulRecoveries, stats.ulWorstLatencyUs,
+		stats.ulBusyUs - before.ulBusyUs);
+	before = stats;
+}
+
+static void flood(unsigned long seconds)
+{
+	static xI2CTransaction descriptors[FLOOD_DESCRIPTORS];
+	static unsigned char data[FLOOD_DESCRIPTORS][2];
+	xQueueHandle done = xQueueCreate(FLOOD_DESCRIPTORS, sizeof(xI2CTransaction *));
+	xI2CTransaction *transaction;
+	struct SimBusStats bus;
+	unsigned long end, completed = 0, started = hostTimeUs;
+	clock_t start;
+	double hostSeconds;
+	int i;
+
+	simClearStats(i2cBUS0);
+	start = clock();
+	for(i=0;i<FLOOD_DESCRIPTORS;++i)
+	{
+		transaction = &descriptors[i];
+		data[i][0] = pcaLS2;
+		data[i][1] = (unsigned char) i;
+		transaction->uxBus = i2cBUS0;
+		transaction->ucAddress = pcaADDRESS;
+		transaction->pucWrite = data[i];
+		transaction->uxWriteLen = 2;
+		transaction->pucRead = NULL;
+		transaction->uxReadLen = 0;
+		transaction->xRepeatedStart = pdFALSE;
+		transaction->ulMaxHz = 0;
+		transaction->uxClient = i % FLOOD_CLIENTS;
+		transaction->xDoneQ = done;
+		xI2CSubmit(transaction, portMAX_DELAY);
+	}
+
+	end = hostTimeUs + seconds * 1000000UL;
+	while(hostTimeUs < end)
+	{
+		xQueueReceive(done, &transaction, portMAX_DELAY);
+		completed++;
+		xI2CSubmit(transaction, portMAX_DELAY);
+	}
+	for(i=0;i<FLOOD_DESCRIPTORS;++i)
+	{
+		xQueueReceive(done, &transaction, portMAX_DELAY);
+	}
+	simRunUntilIdle();
+	hostSeconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+	simGetStats(i2cBUS0, &bus);
+
+	printf("flood: %lu transactions in %.3f simulated s, %.0f a second, bus busy %.1f%%\n",
+		completed, (hostTimeUs - started) / 1e6, completed * 1e6 / (hostTimeUs - started),
+		100.0 * bus.busyUs / (hostTimeUs - started));
+	printf("flood: %.3f host s, %.2f M transactions a second, %.0f ns each\n",
+		hostSeconds, completed / (hostSeconds > 0 ? hostSeconds : 1e-9) / 1e6,
+		hostSeconds * 1e9 / completed);
+	printClients("flood", FLOOD_CLIENTS);
+	printBus("flood");
+}
+
+static void pollAndLights(unsigned long seconds)
+{
+	xQueueHandle done = xQueueCreate(1, sizeof(xI2CTransaction *));
+	xI2CTransaction *read;
+	unsigned long seed = 1, end, nextPoll, nextLight, submitted = 0;
+	unsigned long polls = 0, totalUs = 0, worstUs = 0, lights = 0;
+	int polling = 0;
+
+	vPCA9532SetClients(&expander, CLIENT_POLL, CLIENT_LIGHTS);
+	end = hostTimeUs + seconds * 1000000UL;
+	nextPoll = hostTimeUs;
+	nextLight = hostTimeUs + random32(&seed) % (2 * LIGHTS_MEAN_US);
+
+	while(hostTimeUs < end)
+	{
+		if(!polling && hostTimeUs >= nextPoll)
+		{
+			submitted = hostTimeUs;
+			xPCA9532StartInputRead(&expander, done);
+			polling = 1;
+			nextPoll += POLL_PERIOD_US;
+		}
+		if(hostTimeUs >= nextLight)
+		{
+			vPCA9532SetLed(&expander, random32(&seed) % pcaNUM_LEDS, random32(&seed) & 1);
+			vPCA9532Flush(&expander);
+			lights++;
+			nextLight += 1 + random32(&seed) % (2 * LIGHTS_MEAN_US);
+		}
+
+		simRunUntil(hostTimeUs + STEP_US);
+
+		if(polling && xQueueReceive(done, &read, 0) == pdPASS)
+		{
+			unsigned long us = hostTimeUs - submitted;
+
+			polling = 0;
+			polls++;
+			totalUs += us;
+			if(us > worstUs)
+			{
+				worstUs = us;
+			}
+		}
+	}
+	simRunUntilIdle();
+
+	printf("poll and lights: %lu polls, %lu light changes in %lu simulated s\n", polls, lights, seconds);
+	printf("poll and lights: poll submit to completion %lu us on average, worst %lu us, to within %d us\n",
+		polls ? totalUs / polls : 0, worstUs, STEP_US);
+	printClients("poll and lights", 2);
+	printBus("poll and lights");
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long seconds = argc > 1 ? strtoul(argv[1], NULL, 0) : 2;
+
+	simPCA9532(&device, pcaADDRESS);
+	simAttach(i2cBUS0, &device.device);
+	vPCA9532Init(&expander, i2cBUS0, pcaADDRESS, pdFALSE);
+	/* let the simulated peripheral see it enabled before the first START
+	 * is requested, as i2csim.h only keeps the last write of each */
+	simRunUntilIdle();
+
+	pollAndLights(seconds * 5);
+	flood(seconds);
+	return 0;
+}
@@ -0,0 +1,108 @@
+/* Host benchmark of I2C bus occupancy per sensor poll cycle, before and
+ * after the bus speed change, on the simulated bus.
+ *
+ * Before, SCLL = SCLH = 0x80 ran the bus at Fpclk / 256 (46.9 kHz) and
+ * each poll read INPUT0 alone.  After, SCLL/SCLH come from vI2CSetSpeed()
+ * and each poll reads INPUT0 and INPUT1 in one burst, or the whole
+ * register file with readback on.  For each it reports the time the poll
+ * holds the bus and what share of the 20 ms and 5 ms poll periods that
+ * is, and the same for one LED register write. */
+#include <stdio.h>
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "config.h"
+#include "i2c.h"
+#include "pca9532.h"
+#include "i2csim.h"
+
+#define CYCLES					100
+
+/* the original SCLL = SCLH = 0x80 */
+#define ORIGINAL_HZ				( Fpclk / 256 )
+
+static struct SimPCA9532 device;
+static xPCA9532 expander, checked;
+static xQueueHandle done;
+
+/* bus time and interrupts of one transaction, averaged */
+static void measure(xI2CTransaction *transaction, xPCA9532 *pca, double *us, double *interrupts)
+{
+	struct SimBusStats stats;
+	xI2CTransaction *finished;
+	int i;
+
+	simRunUntilIdle();
+	simClearStats(i2cBUS0);
+	for(i=0;i<CYCLES;++i)
+	{
+		if(pca != NULL)
+		{
+			xPCA9532StartInputRead(pca, done);
+		}
+		else
+		{
+			xI2CSubmit(transaction, portMAX_DELAY);
+		}
+		xQueueReceive(done, &finished, portMAX_DELAY);
+		simRunUntilIdle();
+	}
+	simGetStats(i2cBUS0, &stats);
+	*us = (double) stats.busyUs / CYCLES;
+	*interrupts = (double) stats.interrupts / CYCLES;
+}
+
+static void report(const char *name, unsigned long hz, double pollUs, double interrupts, double writeUs)
+{
+	printf("i2cspeed: %-24s %6lu Hz  poll %7.1f us  %5.2f%% of 20 ms  %5.2f%% of 5 ms  %4.1f interrupts  LED write %6.1f us\n",
+		name, hz, pollUs, pollUs / 200.0, pollUs / 50.0, interrupts, writeUs);
+}
+
+int main(void)
+{
+	static const unsigned char inputControl = pcaINPUT0;
+	static unsigned char ledWrite[2] = { pcaLS2, 0x01 };
+	static unsigned char input;
+	static const unsigned long rates[] = { i2cSTANDARD_MODE_HZ, i2cFAST_MODE_HZ };
+	xI2CTransaction oldPoll, oldWrite;
+	double pollUs, interrupts, writeUs, unused;
+	unsigned int i;
+
+	done = xQueueCreate(1, sizeof(xI2CTransaction *));
+	simPCA9532(&device, pcaADDRESS);
+	simAttach(i2cBUS0, &device.device);
+	vPCA9532Init(&expander, i2cBUS0, pcaADDRESS, pdFALSE);
+	vPCA9532Init(&checked, i2cBUS0, pcaADDRESS, pdTRUE);
+
+	/* the original sequences: INPUT0 alone, and LS2 */
+	oldPoll.uxBus = i2cBUS0;
+	oldPoll.ucAddress = pcaADDRESS;
+	oldPoll.pucWrite = &inputControl;
+	oldPoll.uxWriteLen = 1;
+	oldPoll.pucRead = &input;
+	oldPoll.uxReadLen = 1;
+	oldPoll.xRepeatedStart = pdTRUE;
+	oldPoll.ulMaxHz = 0;
+	oldPoll.uxClient = 0;
+	oldPoll.xDoneQ = done;
+	oldWrite = oldPoll;
+	oldWrite.pucWrite = ledWrite;
+	oldWrite.uxWriteLen = 2;
+	oldWrite.pucRead = NULL;
+	oldWrite.uxReadLen = 0;
+
+	vI2CSetSpeed(i2cBUS0, ORIGINAL_HZ);
+	measure(&oldPoll, NULL, &pollUs, &interrupts);
+	measure(&oldWrite, NULL, &writeUs, &unused);
+	report("before: INPUT0", ORIGINAL_HZ, pollUs, interrupts, writeUs);
+
+	for(i=0;i<sizeof(rates)/sizeof(rates[0]);++i)
+	{
+		vI2CSetSpeed(i2cBUS0, rates[i]);
+		measure(&oldWrite, NULL, &writeUs, &unused);
+		measure(NULL, &expander, &pollUs, &interrupts);
+		report("after: INPUT0-1", rates[i], pollUs, interrupts, writeUs);
+		measure(NULL, &checked, &pollUs, &interrupts);
+		report("after: with readback", rates[i], pollUs, interrupts, writeUs);
+	}
+	return 0;
+}
@@ -0,0 +1,97 @@
+/* Host benchmark of the PCA9532 shadow registers on the door lights.
+ * Replays an event trace through statemachine.c, with every door light it
+ * switches going to a simulated PCA9532 on LEDs 8 and 10 as airlockConfig
+ * has them, and flushed straight away.
+ *
+ * Before the shadow registers each light change was one putLights() write
+ * of LS2, whether or not it changed anything, and the lights were written
+ * once more at start up.  This prints that count next to the register
+ * writes requested, the writes skipped as redundant and the write bursts
+ * actually sent, from vPCA9532GetStats().
+ *
+ *   bench_lights [-w trace file] [trace file] */
+#include <stdio.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "controller.h"
+#include "statemachine.h"
+#include "pca9532.h"
+#include "i2csim.h"
+#include "stubs.h"
+#include "trace.h"
+
+#define SESSIONS				2000
+
+#define OUTER_LED				8
+#define INNER_LED				10
+
+static struct SimPCA9532 device;
+static xPCA9532 expander;
+static unsigned long putLightsCalls;
+
+static void setLed(ulong airlock, enum Door door, int on)
+{
+	(void) airlock;
+	putLightsCalls++;
+	vPCA9532SetLed(&expander, (door == OUTER_DOOR) ? OUTER_LED : INNER_LED, on ? pcaLED_ON : pcaLED_OFF);
+	vPCA9532Flush(&expander);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *out = NULL, *in = NULL;
+	struct ReplayStats replay;
+	xPCA9532Stats stats;
+	int i;
+
+	for(i=1;i<argc;++i)
+	{
+		if(strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+		{
+			out = argv[++i];
+		}
+		else
+		{
+			in = argv[i];
+		}
+	}
+	if(in != NULL)
+	{
+		readTrace(in);
+	}
+	else
+	{
+		generateTrace(SESSIONS);
+	}
+	if(out != NULL)
+	{
+		writeTrace(out);
+	}
+
+	simPCA9532(&device, pcaADDRESS);
+	simAttach(i2cBUS0, &device.device);
+	vPCA9532Init(&expander, i2cBUS0, pcaADDRESS, pdFALSE);
+	simRunUntilIdle();
+
+	/* the controller lights every locked door at start up */
+	putLightsCalls = 1;
+	vPCA9532SetLed(&expander, OUTER_LED, pcaLED_ON);
+	vPCA9532SetLed(&expander, INNER_LED, pcaLED_ON);
+	vPCA9532Flush(&expander);
+
+	stubLightHook = setLed;
+	replayTrace(NULL, simRunUntilIdle, &replay);
+	simRunUntilIdle();
+
+	vPCA9532GetStats(&stats);
+
+	printf("lights: %lu events over %.1f hours, %lu deadlines, %lu transitions\n",
+		replay.events, stubNowMs / 3600000.0, replay.deadlines, replay.transitions);
+	printf("lights: before, one putLights() write each: %lu bus writes\n", putLightsCalls);
+	printf("lights: shadow registers: %lu register writes requested, %lu skipped, %lu write bursts sent (%.0f%% of before)\n",
+		stats.ulWrites, stats.ulWritesSkipped, stats.ulTransactions,
+		100.0 * stats.ulTransactions / putLightsCalls);
+	printf("lights: %lu write errors, LS2 ends %02x\n", stats.ulWriteErrors, device.reg[pcaLS2]);
+	return 0;
+}
@@ -0,0 +1,129 @@
+/* Host benchmark for the airlock state machine.  Feeds statemachine.c a
+ * long random sequence of events and reports how many it handles per
+ * second.  Timer events only reach it while their deadline is armed, as
+ * the controller's deadlineCurrent() check arranges on the target.
+ *
+ * Fails if the state machine counts an invariant violation, or if an
+ * airlock ever has both doors unlocked or open, either in its state or in
+ * the door lights it switched.
+ *
+ * -v prints the state machine's log lines as they are written; with it,
+ * keep the event count small.
+ *
+ *   bench_statemachine [-v] [events [seed]] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "FreeRTOS.h"
+#include "controller.h"
+#include "event.h"
+#include "statemachine.h"
+#include "stubs.h"
+
+#define BOTH_DOORS				(DOOR_BIT(INNER_DOOR) | DOOR_BIT(OUTER_DOOR))
+
+static unsigned long random32(unsigned long *seed)
+{
+	/* xorshift32, so runs repeat across C libraries */
+	unsigned long x = *seed & 0xFFFFFFFFUL;
+
+	x ^= (x << 13) & 0xFFFFFFFFUL;
+	x ^= x >> 17;
+	x ^= (x << 5) & 0xFFFFFFFFUL;
+	*seed = x;
+	return x;
+}
+
+static int isTimerEvent(ulong type)
+{
+	return type == FIVE_SECONDS_PASSED || type == DOOR_HELD_OPEN;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long events = 20000000UL, seed = 1;
+	unsigned long i, handled = 0, stale = 0, transitions = 0;
+	struct Event event = { 0 };
+	ulong airlock;
+	clock_t start;
+	double seconds;
+	int arg = 1;
+
+	if(arg < argc && strcmp(argv[arg], "-v") == 0)
+	{
+		stubLogPrint = 1;
+		arg++;
+	}
+	if(arg < argc)
+	{
+		events = strtoul(argv[arg++], NULL, 0);
+	}
+	if(arg < argc)
+	{
+		seed = strtoul(argv[arg], NULL, 0);
+	}
+	if(seed == 0)
+	{
+		seed = 1;
+	}
+
+	initStateMachine();
+	for(airlock=0;airlock<NUMBER_OF_AIRLOCKS;++airlock)
+	{
+		stubLight[airlock][INNER_DOOR] = 1;
+		stubLight[airlock][OUTER_DOOR] = 1;
+		stubDeadline[airlock] = NO_EVENT;
+	}
+
+	start = clock();
+	for(i=0;i<events;++i)
+	{
+		unsigned long r = random32(&seed);
+
+		event.type = (unsigned char) (r % NUMBER_OF_TRANSITIONS);
+		event.airlock = (unsigned char) ((r >> 8) % NUMBER_OF_AIRLOCKS);
+		event.source = isTimerEvent(event.type) ? SOURCE_TIMER : SOURCE_SENSORS;
+		event.seq++;
+		airlock = event.airlock;
+
+		if(event.source == SOURCE_TIMER)
+		{
+			if(stubDeadline[airlock] != event.type)
+			{
+				stale++;
+				continue;
+			}
+			stubDeadline[airlock] = NO_EVENT;
+		}
+
+		handled++;
+		if(handleEvent(&event))
+		{
+			transitions++;
+			replayDeferred(airlock);
+		}
+
+		if(unlockedDoors(airlock) == BOTH_DOORS ||
+			(!stubLight[airlock][INNER_DOOR] && !stubLight[airlock][OUTER_DOOR]))
+		{
+			printf("event %lu (type %u): airlock %lu has both doors unlocked, state %lu\n",
+				i, event.type, airlock, airlockState(airlock));
+			return 1;
+		}
+	}
+	seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+	if(seconds <= 0)
+	{
+		seconds = 1e-9;
+	}
+
+	printf("statemachine: %lu events (%lu stale timer events dropped), %lu transitions\n",
+		handled, stale, transitions);
+	printf("statemachine: %.3f s, %.1f M events/s, %.1f M transitions/s, %lu light changes\n",
+		seconds, handled / seconds / 1e6, transitions / seconds / 1e6, stubLightChanges);
+	printf("statemachine: %lu invariant violations, %lu alarms\n",
+		invariantViolations(), doorAlarms());
+
+	return invariantViolations() != 0;
+}
@@ -0,0 +1,510 @@
+/* Host build: simulated I2C peripherals.  Each bus follows the LPC24xx
+ * master state machine closely enough for the driver: writes to I2CONSET
+ * and I2CONCLR are picked up after the code that made them returns, the
+ * next bus phase (START, STOP, a byte) is timed from SCLH + SCLL, and when
+ * it ends I2STAT is set and the bus's interrupt handler called.  A phase
+ * the driver did not ask for, such as a START it forgot to clear, happens
+ * just as it would on the chip, so it shows up in the bus log. */
+#include <stdio.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "lpc24xx.h"
+#include "config.h"
+#include "rtos.h"
+#include "i2csim.h"
+
+/* I2CONSET / I2CONCLR bits */
+#define CON_AA					0x04
+#define CON_SI					0x08
+#define CON_STO					0x10
+#define CON_STA					0x20
+#define CON_I2EN				0x40
+
+/* register indexes */
+#define REG_CONSET				0
+#define REG_STAT				1
+#define REG_DAT					2
+#define REG_SCLH				4
+#define REG_SCLL				5
+#define REG_CONCLR				6
+
+volatile unsigned long PCONP;
+volatile unsigned long PINSEL0, PINSEL1;
+volatile unsigned long IODIR0, IOSET0, IOCLR0;
+/* every line reads high, so bus recovery finds SDA released */
+volatile unsigned long IOPIN0 = ~0UL;
+volatile unsigned long VICIntSelect, VICIntEnable, VICVectAddr;
+/* write only, and never acted on: nothing here runs an interrupt handler
+ * while the driver's watchdog has one masked */
+volatile unsigned long VICIntEnClr;
+volatile unsigned long VICSoftInt, VICSoftIntClear;
+volatile unsigned long VICVectAddr9, VICVectPriority9;
+volatile unsigned long VICVectAddr19, VICVectPriority19;
+volatile unsigned long VICVectAddr30, VICVectPriority30;
+volatile unsigned long simI2CRegisters[3][SIM_I2C_REGISTERS];
+
+/* i2c.c's interrupt handlers, and the asm entry points it installs in
+ * the VIC, which are never called here */
+void vI2C0_ISRHandler(void);
+void vI2C1_ISRHandler(void);
+void vI2C2_ISRHandler(void);
+void vI2C0_ISREntry(void) {}
+void vI2C1_ISREntry(void) {}
+void vI2C2_ISREntry(void) {}
+
+static void (*const handlers[SIM_BUSES])(void) =
+{
+	vI2C0_ISRHandler, vI2C1_ISRHandler, vI2C2_ISRHandler
+};
+static const unsigned long vicChannel[SIM_BUSES] =
+{
+	1UL << 9, 1UL << 19, 1UL << 30
+};
+
+enum Mode { MODE_IDLE, MODE_ADDRESS, MODE_WRITE, MODE_READ, MODE_NACKED };
+
+enum Phase
+{
+	PHASE_NONE, PHASE_START, PHASE_RESTART, PHASE_STOP, PHASE_STOP_START,
+	PHASE_ADDRESS, PHASE_WRITE, PHASE_READ
+};
+
+struct SimBus
+{
+	unsigned long con;
+	enum Mode mode;
+	enum Phase phase;			/* on the bus now, ending at dueNs */
+	unsigned long dueNs;
+	unsigned long startedNs;
+	int stuck;
+	struct SimDevice *devices;
+	struct SimDevice *addressed;
+	char log[SIM_LOG_LENGTH];
+	unsigned long logLength;
+	unsigned long busyNs;
+	struct SimBusStats stats;
+};
+
+static struct SimBus buses[SIM_BUSES];
+
+/* nanoseconds, never behind hostTimeUs */
+static unsigned long nowNs;
+
+static void syncNow(void)
+{
+	if(nowNs < hostTimeUs * 1000)
+	{
+		nowNs = hostTimeUs * 1000;
+	}
+}
+
+static void logToken(struct SimBus *bus, const char *format, unsigned int value, int ack)
+{
+	char token[16];
+	int length;
+
+	length = sprintf(token, "%s", bus->logLength ? " " : "");
+	length += sprintf(token + length, format, value);
+	if(ack >= 0)
+	{
+		token[length++] = ack ? '+' : '-';
+		token[length] = '\0';
+	}
+	if(bus->logLength + length < SIM_LOG_LENGTH)
+	{
+		strcpy(bus->log + bus->logLength, token);
+		bus->logLength += length;
+	}
+}
+
+/* apply whatever the driver wrote to I2CONSET and I2CONCLR.  A bit both
+ * cleared and set since the last look ends up set: the driver only writes
+ * them in that order, to clear the state and then request a START */
+static void applyWrites(int index)
+{
+	struct SimBus *bus = &buses[index];
+	volatile unsigned long *regs = simI2CRegisters[index];
+	unsigned long set = regs[REG_CONSET], clear = regs[REG_CONCLR];
+
+	/* there is no STO bit in I2CONCLR, a STOP once asked for goes out */
+	clear &= ~CON_STO;
+
+	regs[REG_CONSET] = 0;
+	regs[REG_CONCLR] = 0;
+
+	/* turning the peripheral off resets it, and lets go of the bus */
+	if((clear & CON_I2EN) && (bus->con & CON_I2EN))
+	{
+		bus->mode = MODE_IDLE;
+		bus->phase = PHASE_NONE;
+		bus->stuck = 0;
+		bus->addressed = NULL;
+	}
+	bus->con = (bus->con & ~clear) | set;
+}
+
+static unsigned long bitNs(int index)
+{
+	volatile unsigned long *regs = simI2CRegisters[index];
+
+	return (regs[REG_SCLH] + regs[REG_SCLL]) * 1000000000UL / Fpclk;
+}
+
+/* start the next phase the registers ask for, if the bus is free to */
+static void schedule(int index)
+{
+	struct SimBus *bus = &buses[index];
+	unsigned long bits;
+
+	if(bus->phase != PHASE_NONE || bus->stuck || !(bus->con & CON_I2EN) || (bus->con & CON_SI))
+	{
+		return;
+	}
+
+	if((bus->con & CON_STO) && bus->mode == MODE_IDLE)
+	{
+		/* nothing to stop */
+		bus->con &= ~CON_STO;
+	}
+
+	if(bus->con & CON_STO)
+	{
+		bus->phase = (bus->con & CON_STA) ? PHASE_STOP_START : PHASE_STOP;
+		bits = (bus->phase == PHASE_STOP_START) ? 2 : 1;
+	}
+	else if(bus->con & CON_STA)
+	{
+		bus->phase = (bus->mode == MODE_IDLE) ? PHASE_START : PHASE_RESTART;
+		bits = 1;
+	}
+	else if(bus->mode == MODE_ADDRESS)
+	{
+		bus->phase = PHASE_ADDRESS;
+		bits = 9;
+	}
+	else if(bus->mode == MODE_WRITE)
+	{
+		bus->phase = PHASE_WRITE;
+		bits = 9;
+	}
+	else if(bus->mode == MODE_READ)
+	{
+		bus->phase = PHASE_READ;
+		bits = 9;
+	}
+	else
+	{
+		return;
+	}
+	bus->startedNs = nowNs;
+	bus->dueNs = nowNs + bits * bitNs(index);
+}
+
+static void interrupt(int index, unsigned long status)
+{
+	struct SimBus *bus = &buses[index];
+
+	bus->con |= CON_SI;
+	simI2CRegisters[index][REG_STAT] = status;
+	bus->stats.interrupts++;
+	if(VICIntEnable & vicChannel[index])
+	{
+		handlers[index]();
+	}
+	applyWrites(index);
+}
+
+static void startCondition(int index, int repeated)
+{
+	struct SimBus *bus = &buses[index];
+
+	logToken(bus, repeated ? "Sr" : "S", 0, -1);
+	bus->stats.starts++;
+	bus->mode = MODE_ADDRESS;
+	interrupt(index, repeated ? 0x10 : 0x08);
+}
+
+static void stopCondition(int index)
+{
+	struct SimBus *bus = &buses[index];
+
+	logToken(bus, "P", 0, -1);
+	if(bus->addressed != NULL && bus->addressed->stop != NULL)
+	{
+		bus->addressed->stop(bus->addressed);
+	}
+	bus->addressed = NULL;
+	bus->mode = MODE_IDLE;
+	bus->con &= ~CON_STO;
+}
+
+static void perform(int index)
+{
+	struct SimBus *bus = &buses[index];
+	volatile unsigned long *regs = simI2CRegisters[index];
+	struct SimDevice *device;
+	enum Phase phase = bus->phase;
+	unsigned char byte;
+	int ack;
+
+	bus->phase = PHASE_NONE;
+	bus->busyNs += bus->dueNs - bus->startedNs;
+
+	switch(phase)
+	{
+		case PHASE_START:
+		case PHASE_RESTART:
+			startCondition(index, phase == PHASE_RESTART);
+			break;
+
+		case PHASE_STOP:
+			stopCondition(index);
+			break;
+
+		case PHASE_STOP_START:
+			stopCondition(index);
+			startCondition(index, 0);
+			break;
+
+		case PHASE_ADDRESS:
+			byte = (unsigned char) regs[REG_DAT];
+			for(device=bus->devices;device!=NULL;device=device->next)
+			{
+				if(device->address == (byte & 0xFE))
+				{
+					break;
+				}
+			}
+			ack = device != NULL && device->start(device, byte & 1);
+			bus->addressed = ack ? device : NULL;
+			bus->stats.bytes++;
+			logToken(bus, "%02X", byte, ack);
+			if(byte & 1)
+			{
+				bus->mode = ack ? MODE_READ : MODE_NACKED;
+				interrupt(index, ack ? 0x40 : 0x48);
+			}
+			else
+			{
+				bus->mode = ack ? MODE_WRITE : MODE_NACKED;
+				interrupt(index, ack ? 0x18 : 0x20);
+			}
+			break;
+
+		case PHASE_WRITE:
+			byte = (unsigned char) regs[REG_DAT];
+			ack = bus->addressed->write(bus->addressed, byte);
+			bus->stats.bytes++;
+			logToken(bus, "%02X", byte, ack);
+			bus->mode = ack ? MODE_WRITE : MODE_NACKED;
+			interrupt(index, ack ? 0x28 : 0x30);
+			break;
+
+		case PHASE_READ:
+			byte = bus->addressed->read(bus->addressed);
+			regs[REG_DAT] = byte;
+			ack = (bus->con & CON_AA) != 0;
+			bus->stats.bytes++;
+			logToken(bus, "%02X", byte, ack);
+			/* after a NACK the master must stop or restart */
+			bus->mode = ack ? MODE_READ : MODE_NACKED;
+			interrupt(index, ack ? 0x50 : 0x58);
+			break;
+
+		case PHASE_NONE:
+			break;
+	}
+}
+
+/* run the earliest bus phase that ends by limitNs */
+static int step(unsigned long limitNs)
+{
+	int index, next = -1;
+
+	syncNow();
+	for(index=0;index<SIM_BUSES;++index)
+	{
+		applyWrites(index);
+	}
+
+	/* a software interrupt, from the driver's watchdog */
+	for(index=0;index<SIM_BUSES;++index)
+	{
+		if(VICSoftInt & VICIntEnable & vicChannel[index])
+		{
+			handlers[index]();
+			VICSoftInt &= ~VICSoftIntClear;
+			VICSoftIntClear = 0;
+			applyWrites(index);
+			return 1;
+		}
+	}
+
+	for(index=0;index<SIM_BUSES;++index)
+	{
+		schedule(index);
+		if(buses[index].phase != PHASE_NONE && (next < 0 || buses[index].dueNs < buses[next].dueNs))
+		{
+			next = index;
+		}
+	}
+	if(next < 0 || buses[next].dueNs > limitNs)
+	{
+		return 0;
+	}
+
+	/* timers that fall due first may reset the bus under the phase */
+	if(buses[next].dueNs / 1000 > hostTimeUs)
+	{
+		hostAdvanceUs(buses[next].dueNs / 1000 - hostTimeUs);
+	}
+	nowNs = buses[next].dueNs;
+	for(index=0;index<SIM_BUSES;++index)
+	{
+		applyWrites(index);
+	}
+	if(buses[next].phase != PHASE_NONE)
+	{
+		perform(next);
+	}
+	return 1;
+}
+
+int simStep(void)
+{
+	return step(~0UL);
+}
+
+void simRunUntil(unsigned long timeUs)
+{
+	while(step(timeUs * 1000))
+	{
+	}
+	if(timeUs > hostTimeUs)
+	{
+		hostAdvanceUs(timeUs - hostTimeUs);
+	}
+}
+
+void simRunUntilIdle(void)
+{
+	while(simStep())
+	{
+	}
+}
+
+/*-----------------------------------------------------------*/
+
+void simAttach(int bus, struct SimDevice *device)
+{
+	device->next = buses[bus].devices;
+	buses[bus].devices = device;
+	hostIdleHook = simStep;
+}
+
+void simStick(int bus)
+{
+	buses[bus].stuck = 1;
+	buses[bus].phase = PHASE_NONE;
+}
+
+const char *simLog(int bus)
+{
+	return buses[bus].log;
+}
+
+void simClearLog(int bus)
+{
+	buses[bus].log[0] = '\0';
+	buses[bus].logLength = 0;
+}
+
+void simGetStats(int bus, struct SimBusStats *stats)
+{
+	*stats = buses[bus].stats;
+	stats->busyUs = buses[bus].busyNs / 1000;
+}
+
+void simClearStats(int bus)
+{
+	memset(&buses[bus].stats, 0, sizeof(buses[bus].stats));
+	buses[bus].busyNs = 0;
+}
+
+/*-----------------------------------------------------------*/
+
+#define PCA_REGISTERS			10
+#define PCA_AUTO_INCREMENT		0x10
+
+static unsigned char pcaNext(struct SimPCA9532 *pca)
+{
+	unsigned char reg = pca->control & 0x0F;
+
+	/* auto-increment wraps from the last register to the first */
+	if(pca->control & PCA_AUTO_INCREMENT)
+	{
+		pca->control = (unsigned char) ((pca->control & 0xF0) | ((reg + 1) % PCA_REGISTERS));
+	}
+	return reg;
+}
+
+static int pcaStart(struct SimDevice *device, int read)
+{
+	struct SimPCA9532 *pca = (struct SimPCA9532 *) device;
+
+	if(!read)
+	{
+		pca->firstByte = 1;
+	}
+	return 1;
+}
+
+static int pcaWrite(struct SimDevice *device, unsigned char byte)
+{
+	struct SimPCA9532 *pca = (struct SimPCA9532 *) device;
+	unsigned char reg;
+
+	if(pca->firstByte)
+	{
+		pca->control = byte;
+		pca->firstByte = 0;
+		return 1;
+	}
+	reg = pcaNext(pca);
+	/* INPUT0 and INPUT1 are read only */
+	if(reg >= 2 && reg < PCA_REGISTERS)
+	{
+		pca->reg[reg] = byte;
+	}
+	pca->bytesWritten++;
+	return 1;
+}
+
+static unsigned char pcaRead(struct SimDevice *device)
+{
+	struct SimPCA9532 *pca = (struct SimPCA9532 *) device;
+	unsigned char reg = pcaNext(pca);
+
+	if(reg == 0)
+	{
+		return (unsigned char) pca->pins;
+	}
+	if(reg == 1)
+	{
+		return (unsigned char) (pca->pins >> 8);
+	}
+	return reg < PCA_REGISTERS ? pca->reg[reg] : 0;
+}
+
+void simPCA9532(struct SimPCA9532 *pca, unsigned char address)
+{
+	memset(pca, 0, sizeof(*pca));
+	pca->device.address = address;
+	pca->device.start = pcaStart;
+	pca->device.write = pcaWrite;
+	pca->device.read = pcaRead;
+	pca->device.stop = NULL;
+	/* power on values: prescalers 0, duty 50%, LEDs off */
+	pca->reg[3] = 0x80;
+	pca->reg[5] = 0x80;
+}
@@ -0,0 +1,72 @@
+/* Host build: a simulated LPC24xx I2C master peripheral per bus, with
+ * slaves on it, driven through the same registers and interrupt handlers
+ * as the real thing.  Bus time follows the programmed SCLH + SCLL.
+ *
+ * I2CONSET and I2CONCLR are plain memory, looked at whenever the simulation
+ * runs, so only the last value written to each between looks counts.  Run
+ * the simulation after setting a bus up and before using it. */
+#ifndef I2CSIM_H
+#define I2CSIM_H
+
+#define SIM_BUSES				3
+#define SIM_LOG_LENGTH			4096
+
+/* a slave: returns are ACKs (nonzero) or NACKs */
+struct SimDevice
+{
+	unsigned char address;		/* 8-bit form, R/W bit clear */
+	int (*start)(struct SimDevice *device, int read);
+	int (*write)(struct SimDevice *device, unsigned char byte);
+	unsigned char (*read)(struct SimDevice *device);
+	void (*stop)(struct SimDevice *device);
+	struct SimDevice *next;
+};
+
+/* a PCA9532: its register file, the register pointer set by the control
+ * byte, and what the input pins read */
+struct SimPCA9532
+{
+	struct SimDevice device;
+	unsigned char reg[10];
+	unsigned char control;
+	int firstByte;				/* next byte written is the control byte */
+	unsigned short pins;
+	unsigned long bytesWritten;
+};
+
+struct SimBusStats
+{
+	unsigned long interrupts;
+	unsigned long bytes;		/* address and data bytes */
+	unsigned long starts;		/* STARTs and repeated STARTs */
+	unsigned long busyUs;		/* time SCL was running */
+};
+
+/* put a slave on a bus */
+void simAttach(int bus, struct SimDevice *device);
+void simPCA9532(struct SimPCA9532 *pca, unsigned char address);
+
+/* run the earliest pending bus phase and the interrupt it raises.
+ * Returns zero if no bus has anything to do.  Installed as hostIdleHook */
+int simStep(void);
+
+/* run every bus until it has nothing left to do */
+void simRunUntilIdle(void);
+
+/* run the buses, and the timers, up to hostTimeUs == timeUs */
+void simRunUntil(unsigned long timeUs);
+
+/* from now on the bus holds SCL low and raises no more interrupts, until
+ * the driver resets the peripheral */
+void simStick(int bus);
+
+/* what went over the bus since the last simClearLog(), for example
+ * "S C0+ 18+ 01+ P": S and Sr are STARTs, P a STOP, and each byte is
+ * followed by + if it was ACKed or - if not */
+const char *simLog(int bus);
+void simClearLog(int bus);
+
+void simGetStats(int bus, struct SimBusStats *stats);
+void simClearStats(int bus);
+
+#endif
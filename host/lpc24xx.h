@@ -0,0 +1,23 @@
+/* Host build: the LPC24xx registers the I2C driver touches, as plain
+ * variables.  i2csim.c gives the I2C blocks their behaviour */
+#ifndef __LPC24xx_H
+#define __LPC24xx_H
+
+extern volatile unsigned long PCONP;
+extern volatile unsigned long PINSEL0, PINSEL1;
+extern volatile unsigned long IODIR0, IOSET0, IOCLR0, IOPIN0;
+extern volatile unsigned long VICIntSelect, VICIntEnable, VICIntEnClr, VICVectAddr;
+extern volatile unsigned long VICSoftInt, VICSoftIntClear;
+extern volatile unsigned long VICVectAddr9, VICVectPriority9;
+extern volatile unsigned long VICVectAddr19, VICVectPriority19;
+extern volatile unsigned long VICVectAddr30, VICVectPriority30;
+
+/* I2CONSET, I2STAT, I2DAT, I2ADR, I2SCLH, I2SCLL, I2CONCLR of each bus */
+#define SIM_I2C_REGISTERS		7
+extern volatile unsigned long simI2CRegisters[3][SIM_I2C_REGISTERS];
+
+#define I2C0_BASE_ADDR			( ( unsigned long ) simI2CRegisters[ 0 ] )
+#define I2C1_BASE_ADDR			( ( unsigned long ) simI2CRegisters[ 1 ] )
+#define I2C2_BASE_ADDR			( ( unsigned long ) simI2CRegisters[ 2 ] )
+
+#endif
@@ -0,0 +1,16 @@
+/* Host build: FreeRTOS queues, see rtos.c */
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include "FreeRTOS.h"
+
+typedef struct HostQueue *xQueueHandle;
+
+xQueueHandle xQueueCreate( unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxItemSize );
+signed portBASE_TYPE xQueueSend( xQueueHandle xQueue, const void *pvItemToQueue, portTickType xTicksToWait );
+signed portBASE_TYPE xQueueReceive( xQueueHandle xQueue, void *pvBuffer, portTickType xTicksToWait );
+signed portBASE_TYPE xQueueSendFromISR( xQueueHandle xQueue, const void *pvItemToQueue, signed portBASE_TYPE *pxHigherPriorityTaskWoken );
+signed portBASE_TYPE xQueueReceiveFromISR( xQueueHandle xQueue, void *pvBuffer, signed portBASE_TYPE *pxHigherPriorityTaskWoken );
+unsigned portBASE_TYPE uxQueueMessagesWaiting( xQueueHandle xQueue );
+
+#endif
@@ -0,0 +1,321 @@
+/* Host build: the FreeRTOS API the drivers use, for one thread running in
+ * simulated time.  Nothing ever waits for real.  When the thread would
+ * block, hostIdleHook runs the simulated hardware, whose interrupts fill
+ * the queue or make room in it; when the hardware has nothing left to do,
+ * time moves on to the next timer.  Waiting forever with neither is a
+ * deadlock, and aborts. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+#include "task.h"
+#include "timers.h"
+#include "mytimer.h"
+#include "rtos.h"
+
+#define HOST_MAX_TIMERS			16
+#define US_PER_TICK				1000UL
+
+struct HostQueue
+{
+	unsigned long length;
+	unsigned long itemSize;
+	unsigned long count;
+	unsigned long head;			/* oldest item */
+	unsigned char *items;
+};
+
+struct HostTimer
+{
+	tmrTIMER_CALLBACK callback;
+	void *id;
+	portTickType period;
+	int autoReload;
+	int active;
+	unsigned long expiryUs;
+};
+
+unsigned long hostTimeUs;
+unsigned long hostTimerCallbacks;
+int hostTimerQueueFull;
+int (*hostIdleHook)(void);
+
+static struct HostTimer timers[HOST_MAX_TIMERS];
+static int timerCount;
+
+static void *allocate(unsigned long size)
+{
+	void *p = calloc(1, size ? size : 1);
+
+	if(p == NULL)
+	{
+		fprintf(stderr, "rtos: out of memory\n");
+		abort();
+	}
+	return p;
+}
+
+/*-----------------------------------------------------------*/
+
+/* earliest active timer due by limitUs, or NULL */
+static struct HostTimer *nextTimer(unsigned long limitUs)
+{
+	struct HostTimer *next = NULL;
+	int i;
+
+	for(i=0;i<timerCount;++i)
+	{
+		if(timers[i].active && timers[i].expiryUs <= limitUs &&
+			(next == NULL || timers[i].expiryUs < next->expiryUs))
+		{
+			next = &timers[i];
+		}
+	}
+	return next;
+}
+
+void hostAdvanceUs(unsigned long us)
+{
+	unsigned long target = hostTimeUs + us;
+	struct HostTimer *timer;
+
+	while((timer = nextTimer(target)) != NULL)
+	{
+		hostTimeUs = timer->expiryUs;
+		if(timer->autoReload)
+		{
+			timer->expiryUs += timer->period * US_PER_TICK;
+		}
+		else
+		{
+			timer->active = 0;
+		}
+		hostTimerCallbacks++;
+		timer->callback(timer);
+	}
+	hostTimeUs = target;
+}
+
+/* let something happen while the thread is blocked until deadlineUs */
+static int block(unsigned long deadlineUs, int forever)
+{
+	struct HostTimer *timer;
+
+	if(hostIdleHook != NULL && hostIdleHook())
+	{
+		return 1;
+	}
+	timer = nextTimer(forever ? ~0UL : deadlineUs);
+	if(timer != NULL)
+	{
+		hostAdvanceUs(timer->expiryUs - hostTimeUs);
+		return 1;
+	}
+	if(forever)
+	{
+		fprintf(stderr, "rtos: deadlock, waiting forever with nothing left to run\n");
+		abort();
+	}
+	if(deadlineUs > hostTimeUs)
+	{
+		hostAdvanceUs(deadlineUs - hostTimeUs);
+	}
+	return 0;
+}
+
+/*-----------------------------------------------------------*/
+
+xQueueHandle xQueueCreate( unsigned portBASE_TYPE uxQueueLength, unsigned portBASE_TYPE uxItemSize )
+{
+	xQueueHandle queue = allocate(sizeof(*queue));
+
+	queue->length = uxQueueLength;
+	queue->itemSize = uxItemSize;
+	queue->items = allocate(uxQueueLength * uxItemSize);
+	return queue;
+}
+
+xSemaphoreHandle xSemaphoreCreateMutex( void )
+{
+	xSemaphoreHandle mutex = xQueueCreate(1, 0);
+
+	mutex->count = 1;
+	return mutex;
+}
+
+signed portBASE_TYPE xQueueSendFromISR( xQueueHandle xQueue, const void *pvItemToQueue, signed portBASE_TYPE *pxHigherPriorityTaskWoken )
+{
+	(void) pxHigherPriorityTaskWoken;
+	if(xQueue->count == xQueue->length)
+	{
+		return errQUEUE_FULL;
+	}
+	if(xQueue->itemSize != 0)
+	{
+		memcpy(xQueue->items + ((xQueue->head + xQueue->count) % xQueue->length) * xQueue->itemSize,
+			pvItemToQueue, xQueue->itemSize);
+	}
+	xQueue->count++;
+	return pdPASS;
+}
+
+signed portBASE_TYPE xQueueReceiveFromISR( xQueueHandle xQueue, void *pvBuffer, signed portBASE_TYPE *pxHigherPriorityTaskWoken )
+{
+	(void) pxHigherPriorityTaskWoken;
+	if(xQueue->count == 0)
+	{
+		return pdFAIL;
+	}
+	if(xQueue->itemSize != 0)
+	{
+		memcpy(pvBuffer, xQueue->items + xQueue->head * xQueue->itemSize, xQueue->itemSize);
+	}
+	xQueue->head = (xQueue->head + 1) % xQueue->length;
+	xQueue->count--;
+	return pdPASS;
+}
+
+signed portBASE_TYPE xQueueSend( xQueueHandle xQueue, const void *pvItemToQueue, portTickType xTicksToWait )
+{
+	unsigned long deadline = hostTimeUs + xTicksToWait * US_PER_TICK;
+
+	while(xQueue->count == xQueue->length)
+	{
+		if(xTicksToWait == 0 || !block(deadline, xTicksToWait == portMAX_DELAY))
+		{
+			return errQUEUE_FULL;
+		}
+	}
+	return xQueueSendFromISR(xQueue, pvItemToQueue, NULL);
+}
+
+signed portBASE_TYPE xQueueReceive( xQueueHandle xQueue, void *pvBuffer, portTickType xTicksToWait )
+{
+	unsigned long deadline = hostTimeUs + xTicksToWait * US_PER_TICK;
+
+	while(xQueue->count == 0)
+	{
+		if(xTicksToWait == 0 || !block(deadline, xTicksToWait == portMAX_DELAY))
+		{
+			return errQUEUE_EMPTY;
+		}
+	}
+	return xQueueReceiveFromISR(xQueue, pvBuffer, NULL);
+}
+
+unsigned portBASE_TYPE uxQueueMessagesWaiting( xQueueHandle xQueue )
+{
+	return xQueue->count;
+}
+
+/*-----------------------------------------------------------*/
+
+portTickType xTaskGetTickCount( void )
+{
+	return hostTimeUs / US_PER_TICK;
+}
+
+portTickType xTaskGetTickCountFromISR( void )
+{
+	return hostTimeUs / US_PER_TICK;
+}
+
+void vTaskDelay( portTickType xTicksToDelay )
+{
+	unsigned long deadline = hostTimeUs + xTicksToDelay * US_PER_TICK;
+
+	while(hostTimeUs < deadline)
+	{
+		block(deadline, 0);
+	}
+}
+
+void vTaskSuspendAll( void )
+{
+}
+
+signed portBASE_TYPE xTaskResumeAll( void )
+{
+	return pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+
+xTimerHandle xTimerCreate( const signed char *pcTimerName, portTickType xTimerPeriodInTicks, unsigned portBASE_TYPE uxAutoReload, void *pvTimerID, tmrTIMER_CALLBACK pxCallbackFunction )
+{
+	struct HostTimer *timer;
+
+	(void) pcTimerName;
+	if(timerCount == HOST_MAX_TIMERS)
+	{
+		return NULL;
+	}
+	timer = &timers[timerCount++];
+	timer->callback = pxCallbackFunction;
+	timer->id = pvTimerID;
+	timer->period = xTimerPeriodInTicks;
+	timer->autoReload = uxAutoReload != 0;
+	timer->active = 0;
+	return timer;
+}
+
+void *pvTimerGetTimerID( xTimerHandle xTimer )
+{
+	return xTimer->id;
+}
+
+portBASE_TYPE xTimerIsTimerActive( xTimerHandle xTimer )
+{
+	return xTimer->active ? pdTRUE : pdFALSE;
+}
+
+portBASE_TYPE xTimerStart( xTimerHandle xTimer, portTickType xBlockTime )
+{
+	if(hostTimerQueueFull && xBlockTime == 0)
+	{
+		return pdFAIL;
+	}
+	/* counted from the current tick, as the timer task does */
+	xTimer->expiryUs = (xTaskGetTickCount() + xTimer->period) * US_PER_TICK;
+	xTimer->active = 1;
+	return pdPASS;
+}
+
+portBASE_TYPE xTimerStop( xTimerHandle xTimer, portTickType xBlockTime )
+{
+	if(hostTimerQueueFull && xBlockTime == 0)
+	{
+		return pdFAIL;
+	}
+	xTimer->active = 0;
+	return pdPASS;
+}
+
+portBASE_TYPE xTimerChangePeriod( xTimerHandle xTimer, portTickType xNewPeriod, portTickType xBlockTime )
+{
+	xTimer->period = xNewPeriod;
+	return xTimerStart(xTimer, xBlockTime);
+}
+
+portBASE_TYPE xTimerStartFromISR( xTimerHandle xTimer, portBASE_TYPE *pxHigherPriorityTaskWoken )
+{
+	(void) pxHigherPriorityTaskWoken;
+	return xTimerStart(xTimer, 0);
+}
+
+portBASE_TYPE xTimerStopFromISR( xTimerHandle xTimer, portBASE_TYPE *pxHigherPriorityTaskWoken )
+{
+	(void) pxHigherPriorityTaskWoken;
+	return xTimerStop(xTimer, 0);
+}
+
+/*-----------------------------------------------------------*/
+
+/* mytimer.c's free running microsecond count.  Simulated runs are far
+ * shorter than its 71 minute wrap */
+unsigned long ulTimestampUs(void)
+{
+	return hostTimeUs;
+}
@@ -0,0 +1,20 @@
+/* Host build: simulated time for rtos.c */
+#ifndef RTOS_H
+#define RTOS_H
+
+/* microseconds since the program started, and timer callbacks run */
+extern unsigned long hostTimeUs;
+extern unsigned long hostTimerCallbacks;
+
+/* nonzero makes timer commands that may not block fail, as they do on the
+ * target while the timer command queue is full */
+extern int hostTimerQueueFull;
+
+/* run by a thread that would block: returns nonzero if it made anything
+ * happen, zero if the simulated hardware is idle */
+extern int (*hostIdleHook)(void);
+
+/* let time pass, running the timers that fall due */
+void hostAdvanceUs(unsigned long us);
+
+#endif
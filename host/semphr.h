@@ -0,0 +1,14 @@
+/* Host build: FreeRTOS mutexes, as queues holding one empty item */
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
+
+#include "queue.h"
+
+typedef xQueueHandle xSemaphoreHandle;
+
+xSemaphoreHandle xSemaphoreCreateMutex( void );
+
+#define xSemaphoreTake( xSemaphore, xBlockTime )	xQueueReceive( ( xSemaphore ), NULL, ( xBlockTime ) )
+#define xSemaphoreGive( xSemaphore )				xQueueSend( ( xSemaphore ), NULL, 0 )
+
+#endif
@@ -0,0 +1,60 @@
+/* Host build: the controller and timer hooks statemachine.c calls.  Door
+ * lights and the armed deadline are recorded so the drivers can check them,
+ * and the lights can be passed on to real outputs */
+#include <stdio.h>
+#include "FreeRTOS.h"
+#include "controller.h"
+#include "statemachine.h"
+#include "mytimer.h"
+#include "log.h"
+#include "stubs.h"
+
+/* lit[airlock][door], on is locked */
+int stubLight[NUMBER_OF_AIRLOCKS][2];
+unsigned long stubLightChanges;
+
+/* the event each airlock's deadline will send, NO_EVENT when not armed */
+ulong stubDeadline[NUMBER_OF_AIRLOCKS];
+
+unsigned long stubNowMs;
+unsigned long stubDeadlineMs[NUMBER_OF_AIRLOCKS];
+
+void (*stubLightHook)(ulong airlock, enum Door door, int on);
+
+unsigned long stubLogLines;
+int stubLogPrint;
+
+void setDoorLight(const struct Event *cause, ulong airlock, enum Door door, int on)
+{
+	(void) cause;
+	if(stubLight[airlock][door] != on)
+	{
+		stubLight[airlock][door] = on;
+		stubLightChanges++;
+	}
+	if(stubLightHook != NULL)
+	{
+		stubLightHook(airlock, door, on);
+	}
+}
+
+void armDeadline(unsigned long airlock, unsigned long ms, unsigned long event)
+{
+	stubDeadline[airlock] = event;
+	stubDeadlineMs[airlock] = stubNowMs + ms;
+}
+
+void cancelDeadline(unsigned long airlock)
+{
+	stubDeadline[airlock] = NO_EVENT;
+}
+
+void logWrite(const char *format, unsigned long a, unsigned long b)
+{
+	stubLogLines++;
+	if(stubLogPrint)
+	{
+		printf(format, a, b);
+		printf("\n");
+	}
+}
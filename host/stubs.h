@@ -0,0 +1,23 @@
+#ifndef STUBS_H
+#define STUBS_H
+
+#include "controller.h"
+#include "statemachine.h"
+
+extern int stubLight[NUMBER_OF_AIRLOCKS][2];
+extern unsigned long stubLightChanges;
+extern ulong stubDeadline[NUMBER_OF_AIRLOCKS];
+
+/* the time deadlines are armed from, kept by the driver, and when each
+ * armed deadline falls due */
+extern unsigned long stubNowMs;
+extern unsigned long stubDeadlineMs[NUMBER_OF_AIRLOCKS];
+
+/* if set, called for every door light the state machine switches */
+extern void (*stubLightHook)(ulong airlock, enum Door door, int on);
+extern unsigned long stubLogLines;
+
+/* nonzero to print log lines as they are written */
+extern int stubLogPrint;
+
+#endif
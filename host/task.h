@@ -0,0 +1,14 @@
+/* Host build: FreeRTOS task functions, see rtos.c.  The tick count is
+ * simulated time */
+#ifndef TASK_H
+#define TASK_H
+
+#include "FreeRTOS.h"
+
+portTickType xTaskGetTickCount( void );
+portTickType xTaskGetTickCountFromISR( void );
+void vTaskDelay( portTickType xTicksToDelay );
+void vTaskSuspendAll( void );
+signed portBASE_TYPE xTaskResumeAll( void );
+
+#endif
@@ -0,0 +1,232 @@
+/* Host test of the PCA9532 driver and the I2C driver under it, against a
+ * simulated PCA9532 register file on a simulated bus.  Checks the exact
+ * bytes each call puts on the bus, for example "S C0+ 18+ 01+ P": the
+ * device writes at 0xC0 and reads at 0xC1, and a control byte is the
+ * register number, plus 0x10 for an auto-increment burst. */
+#include <stdio.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "i2c.h"
+#include "pca9532.h"
+#include "rtos.h"
+#include "i2csim.h"
+
+static int failures;
+
+#define CHECK(condition)		check((condition), #condition, __LINE__)
+
+static void check(int ok, const char *what, int line)
+{
+	if(!ok)
+	{
+		printf("test_pca9532:%d: failed: %s\n", line, what);
+		failures++;
+	}
+}
+
+static void checkLog(const char *expected, int line)
+{
+	if(strcmp(simLog(i2cBUS0), expected) != 0)
+	{
+		printf("test_pca9532:%d: bus log \"%s\", expected \"%s\"\n", line, simLog(i2cBUS0), expected);
+		failures++;
+	}
+	simClearLog(i2cBUS0);
+}
+
+#define CHECK_LOG(expected)		checkLog((expected), __LINE__)
+
+int main(void)
+{
+	static struct SimPCA9532 device, readback;
+	static xPCA9532 expander, checked, missing;
+	xQueueHandle done = xQueueCreate(1, sizeof(xI2CTransaction *));
+	xI2CTransaction *read;
+	xPCA9532Stats stats;
+	unsigned short inputs;
+	unsigned long callbacks, skipped;
+
+	simPCA9532(&device, pcaADDRESS);
+	simAttach(i2cBUS0, &device.device);
+	simPCA9532(&readback, pcaADDRESS + 2);
+	simAttach(i2cBUS0, &readback.device);
+
+	/* setting up sends nothing: the device may have kept its state */
+	vPCA9532Init(&expander, i2cBUS0, pcaADDRESS, pdFALSE);
+	simRunUntilIdle();
+	CHECK_LOG("");
+
+	/* one LED is one register, LS2 holds LEDs 8 to 11 */
+	vPCA9532SetLed(&expander, 8, pcaLED_ON);
+	vPCA9532Flush(&expander);
+	simRunUntilIdle();
+	CHECK_LOG("S C0+ 18+ 01+ P");
+	CHECK(device.reg[pcaLS2] == 0x01);
+
+	/* nothing changed, nothing sent */
+	vPCA9532SetLed(&expander, 8, pcaLED_ON);
+	vPCA9532Flush(&expander);
+	simRunUntilIdle();
+	CHECK_LOG("");
+
+	/* a change and its undo before the flush sends nothing either */
+	vPCA9532SetLed(&expander, 9, pcaLED_ON);
+	vPCA9532SetLed(&expander, 9, pcaLED_OFF);
+	vPCA9532Flush(&expander);
+	simRunUntilIdle();
+	CHECK_LOG("S C0+ 18+ 01+ P");
+
+	/* registers changed together go out as one burst, clean registers
+	 * inside it rewritten from the shadow */
+	vPCA9532SetBlink(&expander, 0, 1000, 50);
+	vPCA9532SetLed(&expander, 10, pcaLED_PWM0);
+	vPCA9532Flush(&expander);
+	simRunUntilIdle();
+	CHECK_LOG("S C0+ 12+ 97+ 80+ 00+ 00+ 00+ 00+ 21+ P");
+	CHECK(device.reg[pcaPSC0] == 151);
+	CHECK(device.reg[pcaPWM0] == 128);
+	CHECK(device.reg[pcaLS2] == 0x21);
+
+	/* both input registers in one auto-increment read */
+	device.pins = 0xA50F;
+	xPCA9532StartInputRead(&expander, done);
+	CHECK(xQueueReceive(done, &read, portMAX_DELAY) == pdPASS);
+	CHECK(read == &expander.xInputRead);
+	CHECK(read->xStatus == i2cOK);
+	simRunUntilIdle();
+	CHECK_LOG("S C0+ 10+ Sr C1+ 0F+ A5- P");
+	CHECK(xPCA9532Inputs(&expander, &inputs) == pdPASS);
+	CHECK(inputs == 0xA50F);
+
+	/* a single register read, no auto-increment */
+	CHECK(ucPCA9532Read(&expander, pcaLS2) == 0x21);
+	simRunUntilIdle();
+	CHECK_LOG("S C0+ 08+ Sr C1+ 21- P");
+
+	/* with readback, every poll reads the whole register file, and a
+	 * register that does not match goes out again on the next flush */
+	vPCA9532Init(&checked, i2cBUS0, pcaADDRESS + 2, pdTRUE);
+	vPCA9532SetLed(&checked, 0, pcaLED_ON);
+	vPCA9532Flush(&checked);
+	simRunUntilIdle();
+	CHECK_LOG("S C2+ 16+ 01+ P");
+	readback.reg[pcaLS0] = 0x00;
+	xPCA9532StartInputRead(&checked, done);
+	xQueueReceive(done, &read, portMAX_DELAY);
+	simRunUntilIdle();
+	CHECK_LOG("S C2+ 10+ Sr C3+ 00+ 00+ 00+ 80+ 00+ 80+ 00+ 00+ 00+ 00- P");
+	xPCA9532Inputs(&checked, &inputs);
+	vPCA9532GetStats(&stats);
+	CHECK(stats.ulReadbackErrors == 1);
+	vPCA9532Flush(&checked);
+	simRunUntilIdle();
+	CHECK_LOG("S C2+ 16+ 01+ P");
+	CHECK(readback.reg[pcaLS0] == 0x01);
+
+	/* nothing at the address: no inputs, rather than the zero shadow */
+	vPCA9532Init(&missing, i2cBUS0, pcaADDRESS + 4, pdFALSE);
+	xPCA9532StartInputRead(&missing, done);
+	xQueueReceive(done, &read, portMAX_DELAY);
+	CHECK(read->xStatus == i2cNACK);
+	simRunUntilIdle();
+	CHECK_LOG("S C4- P");
+	inputs = 0x1234;
+	CHECK(xPCA9532Inputs(&missing, &inputs) == pdFAIL);
+	CHECK(inputs == 0x1234);
+
+	/* a device that stops answering no longer reports its old inputs */
+	device.device.address = pcaADDRESS + 6;
+	xPCA9532StartInputRead(&expander, done);
+	xQueueReceive(done, &read, portMAX_DELAY);
+	simRunUntilIdle();
+	CHECK_LOG("S C0- P");
+	CHECK(xPCA9532Inputs(&expander, &inputs) == pdFAIL);
+	device.device.address = pcaADDRESS;
+	xPCA9532StartInputRead(&expander, done);
+	xQueueReceive(done, &read, portMAX_DELAY);
+	simRunUntilIdle();
+	CHECK_LOG("S C0+ 10+ Sr C1+ 0F+ A5- P");
+	CHECK(xPCA9532Inputs(&expander, &inputs) == pdPASS);
+	CHECK(inputs == 0xA50F);
+
+	/* a burst the device did not take is sent again on the next flush */
+	device.device.address = pcaADDRESS + 6;
+	vPCA9532SetLed(&expander, 11, pcaLED_ON);
+	vPCA9532Flush(&expander);
+	simRunUntilIdle();
+	CHECK_LOG("S C0- P");
+	device.device.address = pcaADDRESS;
+	vPCA9532Flush(&expander);
+	simRunUntilIdle();
+	CHECK_LOG("S C0+ 18+ 61+ P");
+	CHECK(device.reg[pcaLS2] == 0x61);
+	vPCA9532GetStats(&stats);
+	CHECK(stats.ulWriteErrors == 1);
+
+	/* and setting the same value again in between is not skipped */
+	device.device.address = pcaADDRESS + 6;
+	vPCA9532SetLed(&expander, 11, pcaLED_OFF);
+	vPCA9532Flush(&expander);
+	simRunUntilIdle();
+	CHECK_LOG("S C0- P");
+	device.device.address = pcaADDRESS;
+	vPCA9532GetStats(&stats);
+	skipped = stats.ulWritesSkipped;
+	vPCA9532SetLed(&expander, 11, pcaLED_OFF);
+	vPCA9532GetStats(&stats);
+	CHECK(stats.ulWritesSkipped == skipped);
+	vPCA9532Flush(&expander);
+	simRunUntilIdle();
+	CHECK_LOG("S C0+ 18+ 21+ P");
+	CHECK(device.reg[pcaLS2] == 0x21);
+
+	/* the input reads and the writes queued behind them share one bus */
+	vPCA9532SetLed(&expander, 8, pcaLED_OFF);
+	xPCA9532StartInputRead(&expander, done);
+	vPCA9532Flush(&expander);
+	xQueueReceive(done, &read, portMAX_DELAY);
+	simRunUntilIdle();
+	CHECK_LOG("S C0+ 10+ Sr C1+ 0F+ A5- P S C0+ 18+ 20+ P");
+
+	/* a slave holding SCL low is caught by the watchdog, which frees the
+	 * bus for the next transaction */
+	simStick(i2cBUS0);
+	xPCA9532StartInputRead(&expander, done);
+	xQueueReceive(done, &read, portMAX_DELAY);
+	CHECK(read->xStatus == i2cTIMEOUT);
+	CHECK(xPCA9532Inputs(&expander, &inputs) == pdFAIL);
+	simRunUntilIdle();
+	simClearLog(i2cBUS0);
+	xPCA9532StartInputRead(&expander, done);
+	xQueueReceive(done, &read, portMAX_DELAY);
+	CHECK(read->xStatus == i2cOK);
+	simRunUntilIdle();
+	CHECK_LOG("S C0+ 10+ Sr C1+ 0F+ A5- P");
+
+	/* with the timer command queue full the submit waits to start the
+	 * watchdog, rather than leave a stuck bus unguarded */
+	hostTimerQueueFull = 1;
+	simStick(i2cBUS0);
+	xPCA9532StartInputRead(&expander, done);
+	xQueueReceive(done, &read, portMAX_DELAY);
+	CHECK(read->xStatus == i2cTIMEOUT);
+	simRunUntilIdle();
+	hostTimerQueueFull = 0;
+	simClearLog(i2cBUS0);
+
+	/* the stop sent as the bus went idle was lost too, so the watchdog
+	 * stops itself the next time it finds the bus idle */
+	simRunUntil(hostTimeUs + 100000);
+
+	/* the watchdog only runs while the bus is busy */
+	callbacks = hostTimerCallbacks;
+	simRunUntil(hostTimeUs + 100000);
+	CHECK(hostTimerCallbacks == callbacks);
+
+	if(failures == 0)
+	{
+		printf("test_pca9532: all passed\n");
+	}
+	return failures != 0;
+}
@@ -0,0 +1,20 @@
+/* Host build: FreeRTOS software timers, see rtos.c.  Callbacks run as
+ * simulated time passes them */
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#include "FreeRTOS.h"
+
+typedef struct HostTimer *xTimerHandle;
+typedef void ( *tmrTIMER_CALLBACK )( xTimerHandle xTimer );
+
+xTimerHandle xTimerCreate( const signed char *pcTimerName, portTickType xTimerPeriodInTicks, unsigned portBASE_TYPE uxAutoReload, void *pvTimerID, tmrTIMER_CALLBACK pxCallbackFunction );
+void *pvTimerGetTimerID( xTimerHandle xTimer );
+portBASE_TYPE xTimerIsTimerActive( xTimerHandle xTimer );
+portBASE_TYPE xTimerStart( xTimerHandle xTimer, portTickType xBlockTime );
+portBASE_TYPE xTimerStop( xTimerHandle xTimer, portTickType xBlockTime );
+portBASE_TYPE xTimerChangePeriod( xTimerHandle xTimer, portTickType xNewPeriod, portTickType xBlockTime );
+portBASE_TYPE xTimerStartFromISR( xTimerHandle xTimer, portBASE_TYPE *pxHigherPriorityTaskWoken );
+portBASE_TYPE xTimerStopFromISR( xTimerHandle xTimer, portBASE_TYPE *pxHigherPriorityTaskWoken );
+
+#endif
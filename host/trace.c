@@ -0,0 +1,284 @@
+/* Host build: generate, load, save and replay an airlock event trace */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "controller.h"
+#include "event.h"
+#include "statemachine.h"
+#include "stubs.h"
+#include "trace.h"
+
+struct TraceEvent *trace;
+unsigned long traceLength;
+
+static unsigned long traceSize;
+
+static unsigned long random32(unsigned long *seed)
+{
+	/* xorshift32, so runs repeat across C libraries */
+	unsigned long x = *seed & 0xFFFFFFFFUL;
+
+	x ^= (x << 13) & 0xFFFFFFFFUL;
+	x ^= x >> 17;
+	x ^= (x << 5) & 0xFFFFFFFFUL;
+	*seed = x;
+	return x;
+}
+
+static void addEvent(unsigned long ms, int type, int airlock)
+{
+	if(traceLength == traceSize)
+	{
+		traceSize = traceSize ? traceSize * 2 : 4096;
+		trace = realloc(trace, traceSize * sizeof(trace[0]));
+		if(trace == NULL)
+		{
+			fprintf(stderr, "out of memory\n");
+			exit(2);
+		}
+	}
+	trace[traceLength].ms = ms;
+	trace[traceLength].type = (unsigned char) type;
+	trace[traceLength].airlock = (unsigned char) airlock;
+	traceLength++;
+}
+
+/* a button pressed once, or a few times while nothing seems to happen */
+static unsigned long pressButton(unsigned long *seed, unsigned long ms, int type, int airlock)
+{
+	unsigned long presses = 1 + random32(seed) % 3;
+
+	addEvent(ms, type, airlock);
+	while(--presses > 0)
+	{
+		ms += 150 + random32(seed) % 450;
+		addEvent(ms, type, airlock);
+	}
+	return ms;
+}
+
+/* someone going through one airlock, from outside in or inside out.  Each
+ * event is stamped with the poll that saw it, so inputs that changed in the
+ * same poll share a millisecond */
+static unsigned long passThrough(unsigned long *seed, unsigned long ms, int airlock)
+{
+	int inward = random32(seed) & 1;
+	int firstButton = inward ? OUTDOOR_BTN_PRESSED : INDOOR_BTN_PRESSED;
+	int firstOpen = inward ? OUTDOOR_OPEN : INDOOR_OPEN;
+	int firstClose = inward ? OUTDOOR_CLOSE : INDOOR_CLOSE;
+	int secondButton = inward ? INDOOR_BTN_PRESSED : OUTDOOR_BTN_PRESSED;
+	int secondOpen = inward ? INDOOR_OPEN : OUTDOOR_OPEN;
+	int secondClose = inward ? INDOOR_CLOSE : OUTDOOR_CLOSE;
+	unsigned long held;
+
+	if(inward && random32(seed) % 4 == 0)
+	{
+		/* the keypad, and the button pressed with it */
+		addEvent(ms, PASSWORD_APPROVED, airlock);
+		if(random32(seed) & 1)
+		{
+			addEvent(ms, OUTDOOR_BTN_PRESSED, airlock);
+		}
+	}
+	else
+	{
+		ms = pressButton(seed, ms, firstButton, airlock);
+	}
+
+	/* changed their mind: the door locks again on its own */
+	if(random32(seed) % 8 == 0)
+	{
+		return ms + 6000;
+	}
+
+	ms += 1000 + random32(seed) % 3000;
+	addEvent(ms, firstOpen, airlock);
+
+	/* now and then held open past the alarm */
+	held = (random32(seed) % 16 == 0) ? 31000 + random32(seed) % 5000 : 2000 + random32(seed) % 6000;
+
+	/* someone on the other side pressing early, which waits */
+	if(random32(seed) % 4 == 0)
+	{
+		addEvent(ms + 1 + random32(seed) % (held - 1), secondButton, airlock);
+	}
+
+	ms += held;
+	addEvent(ms, firstClose, airlock);
+
+	/* the far button pressed as the door shuts, in the same poll */
+	if(!(random32(seed) & 1))
+	{
+		ms += 300 + random32(seed) % 3000;
+	}
+	ms = pressButton(seed, ms, secondButton, airlock);
+
+	ms += 1000 + random32(seed) % 3000;
+	addEvent(ms, secondOpen, airlock);
+	ms += 2000 + random32(seed) % 6000;
+	addEvent(ms, secondClose, airlock);
+	return ms;
+}
+
+void generateTrace(unsigned long sessions)
+{
+	unsigned long seed = 1, ms = 0;
+
+	traceLength = 0;
+	while(sessions-- > 0)
+	{
+		ms += 3000 + random32(&seed) % 27000;
+		ms = passThrough(&seed, ms, (int) (random32(&seed) % NUMBER_OF_AIRLOCKS));
+	}
+}
+
+void readTrace(const char *name)
+{
+	FILE *file = fopen(name, "r");
+	char line[80];
+	unsigned long ms;
+	unsigned int type, airlock;
+
+	if(file == NULL)
+	{
+		perror(name);
+		exit(2);
+	}
+	traceLength = 0;
+	while(fgets(line, sizeof(line), file) != NULL)
+	{
+		if(line[0] == '#' || sscanf(line, "%lu %u %u", &ms, &type, &airlock) != 3)
+		{
+			continue;
+		}
+		if(type >= NUMBER_OF_TRANSITIONS || airlock >= NUMBER_OF_AIRLOCKS ||
+			(traceLength > 0 && ms < trace[traceLength - 1].ms))
+		{
+			fprintf(stderr, "%s: bad event \"%lu %u %u\"\n", name, ms, type, airlock);
+			exit(2);
+		}
+		addEvent(ms, (int) type, (int) airlock);
+	}
+	fclose(file);
+}
+
+void writeTrace(const char *name)
+{
+	FILE *file = fopen(name, "w");
+	unsigned long i;
+
+	if(file == NULL)
+	{
+		perror(name);
+		exit(2);
+	}
+	fprintf(file, "# ms, event type, airlock; deadline events are not included\n");
+	for(i=0;i<traceLength;++i)
+	{
+		fprintf(file, "%lu %u %u\n", trace[i].ms, trace[i].type, trace[i].airlock);
+	}
+	fclose(file);
+}
+
+static void handle(struct Event *event, void (*afterTransition)(void), struct ReplayStats *stats)
+{
+	if(handleEvent(event))
+	{
+		replayDeferred(event->airlock);
+		stats->transitions++;
+		if(afterTransition != NULL)
+		{
+			afterTransition();
+		}
+	}
+}
+
+/* handle the earliest deadline due by limitMs as a batch of its own.
+ * Returns zero if there is none */
+static int fireDeadline(unsigned long limitMs, void (*afterTransition)(void), void (*afterBatch)(void), struct ReplayStats *stats)
+{
+	struct Event event = { 0 };
+	ulong airlock, due = NUMBER_OF_AIRLOCKS;
+
+	for(airlock=0;airlock<NUMBER_OF_AIRLOCKS;++airlock)
+	{
+		if(stubDeadline[airlock] != NO_EVENT && stubDeadlineMs[airlock] <= limitMs &&
+			(due == NUMBER_OF_AIRLOCKS || stubDeadlineMs[airlock] < stubDeadlineMs[due]))
+		{
+			due = airlock;
+		}
+	}
+	if(due == NUMBER_OF_AIRLOCKS)
+	{
+		return 0;
+	}
+
+	stubNowMs = stubDeadlineMs[due];
+	event.type = (unsigned char) stubDeadline[due];
+	event.source = SOURCE_TIMER;
+	event.airlock = (unsigned char) due;
+	event.timestamp = stubNowMs * 1000;
+	stubDeadline[due] = NO_EVENT;
+
+	stats->deadlines++;
+	handle(&event, afterTransition, stats);
+	stats->batches++;
+	if(afterBatch != NULL)
+	{
+		afterBatch();
+	}
+	return 1;
+}
+
+void replayTrace(void (*afterTransition)(void), void (*afterBatch)(void), struct ReplayStats *stats)
+{
+	struct Event event = { 0 };
+	unsigned long i = 0, count;
+	ulong airlock;
+
+	memset(stats, 0, sizeof(*stats));
+	initStateMachine();
+	stubNowMs = 0;
+	for(airlock=0;airlock<NUMBER_OF_AIRLOCKS;++airlock)
+	{
+		stubLight[airlock][INNER_DOOR] = 1;
+		stubLight[airlock][OUTER_DOOR] = 1;
+		stubDeadline[airlock] = NO_EVENT;
+	}
+
+	while(i < traceLength)
+	{
+		/* deadlines go off before the next poll sees anything */
+		if(fireDeadline(trace[i].ms, afterTransition, afterBatch, stats))
+		{
+			continue;
+		}
+
+		stubNowMs = trace[i].ms;
+		count = 0;
+		do
+		{
+			event.type = trace[i].type;
+			event.source = (event.type == PASSWORD_APPROVED) ? SOURCE_KEYPAD : SOURCE_SENSORS;
+			event.airlock = trace[i].airlock;
+			event.seq++;
+			event.timestamp = stubNowMs * 1000;
+			stats->events++;
+			handle(&event, afterTransition, stats);
+			++i;
+			++count;
+		} while(i < traceLength && trace[i].ms == stubNowMs && count < CONTROLLER_BATCH_LENGTH);
+
+		stats->batches++;
+		if(afterBatch != NULL)
+		{
+			afterBatch();
+		}
+	}
+
+	/* and the ones left armed at the end */
+	while(fireDeadline(~0UL, afterTransition, afterBatch, stats))
+	{
+	}
+}
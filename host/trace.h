@@ -0,0 +1,40 @@
+/* Host build: a trace of airlock events for the benchmarks that replay what
+ * the controller task sees.  Button, door and password events come from the
+ * trace; deadline events are raised by the replay when the deadlines the
+ * state machine armed fall due. */
+#ifndef TRACE_H
+#define TRACE_H
+
+struct TraceEvent
+{
+	unsigned long ms;			/* when the input was sampled */
+	unsigned char type;			/* enum EventType */
+	unsigned char airlock;
+};
+
+extern struct TraceEvent *trace;
+extern unsigned long traceLength;
+
+/* people going through the airlocks, the same trace every run */
+void generateTrace(unsigned long sessions);
+
+/* "ms type airlock" per line, # starts a comment line */
+void readTrace(const char *name);
+void writeTrace(const char *name);
+
+struct ReplayStats
+{
+	unsigned long events;		/* trace events handled */
+	unsigned long deadlines;	/* deadline events handled */
+	unsigned long transitions;
+	unsigned long batches;
+};
+
+/* feed the trace through statemachine.c the way the controller task does:
+ * events sampled in the same millisecond arrive together and are handled as
+ * one batch of up to CONTROLLER_BATCH_LENGTH, and a deadline that falls due
+ * is a batch of its own.  afterTransition and afterBatch, if not NULL, are
+ * called after each event that changed state and after each batch */
+void replayTrace(void (*afterTransition)(void), void (*afterBatch)(void), struct ReplayStats *stats);
+
+#endif
@@ -0,0 +1,812 @@
+/*
+	Interrupt driven I2C master driver for I2C0, I2C1 and I2C2.
+
+	Each bus runs its own master state machine in its own interrupt (VIC
+	channels 9, 19 and 30).  Tasks post transaction descriptors to the
+	submission queue of the bus named in the descriptor and carry on; the
+	interrupt handler runs them back to back and posts each finished
+	descriptor to its owner's completion queue.  The buses are independent,
+	so transactions on different buses run at the same time.
+
+	Every finished transaction is passed to the tracer in i2ctrace.c with
+	microsecond start and end times.
+
+	Every bus phase has a deadline.  A watchdog timer aborts a transaction
+	that stops making progress (e.g. a slave holding SDA or SCL low), clocks
+	the bus free by hand and re-initialises the peripheral, so the time any
+	transaction can take is bounded.
+*/
+
+/* Scheduler includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "timers.h"
+#include "lpc24xx.h"
+#include "config.h"
+
+#include "mytimer.h"
+#include "i2c.h"
+#include "i2ctrace.h"
+
+/*-----------------------------------------------------------*/
+
+/* I2CONSET / I2CONCLR bits */
+#define I2C_AA      0x00000004
+#define I2C_SI      0x00000008
+#define I2C_STO     0x00000010
+#define I2C_STA     0x00000020
+#define I2C_I2EN    0x00000040
+
+/* I2STAT codes for master transmitter and master receiver modes */
+#define i2cSTAT_BUS_ERROR		0x00
+#define i2cSTAT_START			0x08
+#define i2cSTAT_REP_START		0x10
+#define i2cSTAT_SLAW_ACK		0x18
+#define i2cSTAT_SLAW_NACK		0x20
+#define i2cSTAT_DATA_TX_ACK		0x28
+#define i2cSTAT_DATA_TX_NACK	0x30
+#define i2cSTAT_ARB_LOST		0x38
+#define i2cSTAT_SLAR_ACK		0x40
+#define i2cSTAT_SLAR_NACK		0x48
+#define i2cSTAT_DATA_RX_ACK		0x50
+#define i2cSTAT_DATA_RX_NACK	0x58
+#define i2cSTAT_ABORT			0xFF	/* not a hardware code, see xAbortPending */
+
+/* VIC priority, the same for every bus. */
+#define i2cVIC_PRIORITY			( ( unsigned long ) 10 )
+
+/* Busy-wait count for half an SCL period (>5us) during bus recovery */
+#define i2cRECOVERY_DELAY		( ( unsigned long ) 120 )
+
+/* Clock pulses that free any slave part way through a byte */
+#define i2cRECOVERY_CLOCKS		9
+
+/* A phase that has not finished within this many ticks has failed.  The
+watchdog checks every period while the bus is busy, so a stuck phase is
+caught within two. */
+#define i2cPHASE_DEADLINE		( ( portTickType ) 2 )
+
+/* STARTs reissued after losing arbitration before giving up */
+#define i2cMAX_RETRIES			( ( unsigned portBASE_TYPE ) 3 )
+
+/* Minimum SCLH / SCLL count allowed by the peripheral */
+#define i2cMIN_SCL_COUNT		( ( unsigned long ) 4 )
+
+/* R/W bit of the address byte */
+#define i2cREAD					( ( unsigned char ) 0x01 )
+
+/*-----------------------------------------------------------*/
+
+/* The register block, laid out the same for every I2C peripheral. */
+typedef struct I2C_REGISTERS
+{
+	volatile unsigned long ulConSet;		/* I2CONSET */
+	volatile unsigned long ulStat;			/* I2STAT */
+	volatile unsigned long ulDat;			/* I2DAT */
+	volatile unsigned long ulAdr;			/* I2ADR */
+	volatile unsigned long ulSclH;			/* I2SCLH */
+	volatile unsigned long ulSclL;			/* I2SCLL */
+	volatile unsigned long ulConClr;		/* I2CONCLR */
+} xI2CRegisters;
+
+/* Where one peripheral lives: registers, power, VIC slot and pins.  All
+three buses use port 0 pins, so bus recovery can drive them as GPIO. */
+typedef struct I2C_PORT
+{
+	xI2CRegisters *pxRegs;
+	unsigned long ulPowerBit;				/* PCONP */
+	unsigned long ulVICChannelBit;
+	volatile unsigned long *pulVectAddr;
+	volatile unsigned long *pulVectPriority;
+	void ( *pvISREntry )( void );
+	volatile unsigned long *pulPinSel;
+	unsigned long ulPinSelMask;
+	unsigned long ulPinSelI2C;
+	unsigned long ulSDAPin;					/* port 0 bits */
+	unsigned long ulSCLPin;
+} xI2CPort;
+
+/* Driver state for one bus. */
+typedef struct I2C_BUS
+{
+	const xI2CPort *pxPort;
+
+	/* Transactions waiting for the bus. */
+	xQueueHandle xSubmitQ;
+
+	/* The transaction currently owned by the interrupt handler, and its
+	progress through the write and read buffers. */
+	xI2CTransaction *pxCurrent;
+	const unsigned char *pucXferWrite;
+	unsigned portBASE_TYPE uxXferWriteLen;
+	unsigned char *pucXferRead;
+	unsigned portBASE_TYPE uxXferReadLen;
+
+	/* Rate set by vI2CSetSpeed(), and the rate SCLL/SCLH are programmed
+	for. */
+	unsigned long ulBusHz;
+	unsigned long ulProgrammedHz;
+
+	/* Incremented on every interrupt and every START, so the watchdog can
+	tell whether the current phase has finished since it last looked.  The
+	watchdog only runs while xBusBusy is pdTRUE. */
+	volatile unsigned long ulPhaseCount;
+	unsigned long ulWatchdogCount;
+	xTimerHandle xWatchdog;
+
+	/* Set by the watchdog once the bus has been recovered; the interrupt
+	handler then completes the current transaction with i2cTIMEOUT. */
+	volatile portBASE_TYPE xAbortPending;
+
+	/* Arbitration retries used by the current transaction. */
+	unsigned portBASE_TYPE uxRetries;
+
+	/* When the current transaction's first START was requested, for the
+	tracer. */
+	unsigned long ulStartUs;
+
+	xI2CStats xStats;
+	xI2CClientStats xClientStats[ i2cMAX_CLIENTS ];
+
+	/* pdTRUE from the START of a transaction until the submission queue
+	has been drained. */
+	volatile portBASE_TYPE xBusBusy;
+} xI2CBus;
+
+/*-----------------------------------------------------------*/
+
+/*
+ * The asm wrappers for the interrupt service routines.
+ */
+extern void vI2C0_ISREntry( void );
+extern void vI2C1_ISREntry( void );
+extern void vI2C2_ISREntry( void );
+
+/*
+ * The C functions called from the asm wrappers.
+ */
+void vI2C0_ISRHandler( void );
+void vI2C1_ISRHandler( void );
+void vI2C2_ISRHandler( void );
+
+/*-----------------------------------------------------------*/
+
+/* I2C0 on P0.27 (SDA) / P0.28 (SCL), I2C1 on P0.19 / P0.20 and I2C2 on
+P0.10 / P0.11.  Only the I2C0 pins are true open drain; the others need
+external pull-ups. */
+static const xI2CPort xPorts[ i2cNUM_BUSES ] =
+{
+	{
+		( xI2CRegisters * ) I2C0_BASE_ADDR, ( 1UL << 7 ), ( 1UL << 9 ),
+		&VICVectAddr9, &VICVectPriority9, vI2C0_ISREntry,
+		&PINSEL1, 0x03C00000UL, 0x01400000UL, ( 1UL << 27 ), ( 1UL << 28 )
+	},
+	{
+		( xI2CRegisters * ) I2C1_BASE_ADDR, ( 1UL << 19 ), ( 1UL << 19 ),
+		&VICVectAddr19, &VICVectPriority19, vI2C1_ISREntry,
+		&PINSEL1, 0x000003C0UL, 0x000003C0UL, ( 1UL << 19 ), ( 1UL << 20 )
+	},
+	{
+		( xI2CRegisters * ) I2C2_BASE_ADDR, ( 1UL << 26 ), ( 1UL << 30 ),
+		&VICVectAddr30, &VICVectPriority30, vI2C2_ISREntry,
+		&PINSEL0, 0x00F00000UL, 0x00A00000UL, ( 1UL << 10 ), ( 1UL << 11 )
+	}
+};
+
+static xI2CBus xBuses[ i2cNUM_BUSES ];
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Program SCLL/SCLH for the given SCL rate.
+ */
+static void prvSetClock( xI2CBus *pxBus, unsigned long ulHz );
+
+/*
+ * Watchdog timer callback, checks that the current phase has moved on.
+ */
+static void prvWatchdog( xTimerHandle xTimer );
+
+/*
+ * Free a bus held by a slave: clock SCL by hand until SDA is released,
+ * send a STOP and re-initialise the peripheral.  Runs with interrupts
+ * enabled; the caller masks the bus's own VIC channel.
+ */
+static void prvRecoverBus( xI2CBus *pxBus );
+
+/*
+ * Drive bus pins low (pdTRUE) or release them (pdFALSE).
+ */
+static void prvSetPinsOutput( unsigned long ulPins, portBASE_TYPE xOutput );
+
+/*
+ * Point the buffer cursors back at the start of the current transaction.
+ */
+static void prvRewind( xI2CBus *pxBus );
+
+/*
+ * Make pxTransaction the current transaction.  When xStopFirst is pdTRUE the
+ * previous transaction's STOP and the new START are requested together.
+ * xQueued is pdTRUE if the transaction had to wait for the bus.
+ */
+static void prvStartTransaction( xI2CBus *pxBus, xI2CTransaction *pxTransaction, portBASE_TYPE xStopFirst, portBASE_TYPE xQueued );
+
+/*
+ * The state machine shared by the three interrupt handlers.
+ */
+static void prvHandleInterrupt( xI2CBus *pxBus );
+
+/*-----------------------------------------------------------*/
+
+void vI2CInit( unsigned portBASE_TYPE uxBus )
+{
+xI2CBus *pxBus = &xBuses[ uxBus ];
+const xI2CPort *pxPort = &xPorts[ uxBus ];
+
+	if( pxBus->xSubmitQ != NULL )
+	{
+		/* Already running, several devices may share the bus. */
+		return;
+	}
+
+	pxBus->pxPort = pxPort;
+	pxBus->xSubmitQ = xQueueCreate( i2cQUEUE_LENGTH, ( unsigned portBASE_TYPE ) sizeof( xI2CTransaction * ) );
+	pxBus->xBusBusy = pdFALSE;
+	pxBus->xAbortPending = pdFALSE;
+
+	/* Started when the bus goes busy, stopped when it goes idle. */
+	pxBus->xWatchdog = xTimerCreate( ( const signed char * ) "I2C", i2cPHASE_DEADLINE, pdTRUE, ( void * ) pxBus, prvWatchdog );
+
+	/* Enable power for the peripheral */
+	PCONP    |=  pxPort->ulPowerBit;
+
+	/* Initialize pins for SDA and SCL functions */
+	*pxPort->pulPinSel &= ~pxPort->ulPinSelMask;
+	*pxPort->pulPinSel |=  pxPort->ulPinSelI2C;
+
+	/* Clear I2C state machine                                                  */
+	pxPort->pxRegs->ulConClr = I2C_AA | I2C_SI | I2C_STA | I2C_I2EN;
+
+	/* Setup I2C clock speed                                                    */
+	pxBus->ulBusHz = i2cFAST_MODE_HZ;
+	prvSetClock( pxBus, pxBus->ulBusHz );
+
+	pxPort->pxRegs->ulConSet = I2C_I2EN;
+
+	portENTER_CRITICAL();
+	{
+		/* Setup the VIC for this bus. */
+		VICIntSelect &= ~pxPort->ulVICChannelBit;
+		*pxPort->pulVectAddr = ( unsigned long ) pxPort->pvISREntry;
+		*pxPort->pulVectPriority = i2cVIC_PRIORITY;
+		VICIntEnable |= pxPort->ulVICChannelBit;
+	}
+	portEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+void vI2CSetSpeed( unsigned portBASE_TYPE uxBus, unsigned long ulHz )
+{
+	xBuses[ uxBus ].ulBusHz = ulHz;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetClock( xI2CBus *pxBus, unsigned long ulHz )
+{
+unsigned long ulDivisor, ulLow, ulHigh;
+
+	/* One SCL period is SCLL + SCLH PCLK cycles.  Round the divisor up so
+	the bus never runs faster than asked. */
+	ulDivisor = ( Fpclk + ulHz - 1 ) / ulHz;
+
+	if( ulHz > i2cSTANDARD_MODE_HZ )
+	{
+		/* Fast-mode needs tLOW >= 1.3us but only tHIGH >= 0.6us, so give
+		the low phase 60% of the period. */
+		ulLow = ( ulDivisor * 3 + 4 ) / 5;
+	}
+	else
+	{
+		/* Standard mode: tLOW >= 4.7us, tHIGH >= 4.0us, an even split. */
+		ulLow = ( ulDivisor + 1 ) / 2;
+	}
+	ulHigh = ulDivisor - ulLow;
+
+	if( ulLow < i2cMIN_SCL_COUNT )
+	{
+		ulLow = i2cMIN_SCL_COUNT;
+	}
+	if( ulHigh < i2cMIN_SCL_COUNT )
+	{
+		ulHigh = i2cMIN_SCL_COUNT;
+	}
+
+	pxBus->pxPort->pxRegs->ulSclL = ulLow;
+	pxBus->pxPort->pxRegs->ulSclH = ulHigh;
+	pxBus->ulProgrammedHz = ulHz;
+}
+/*-----------------------------------------------------------*/
+
+static void prvRewind( xI2CBus *pxBus )
+{
+	pxBus->pucXferWrite = pxBus->pxCurrent->pucWrite;
+	pxBus->uxXferWriteLen = pxBus->pxCurrent->uxWriteLen;
+	pxBus->pucXferRead = pxBus->pxCurrent->pucRead;
+	pxBus->uxXferReadLen = pxBus->pxCurrent->uxReadLen;
+}
+/*-----------------------------------------------------------*/
+
+static void prvStartTransaction( xI2CBus *pxBus, xI2CTransaction *pxTransaction, portBASE_TYPE xStopFirst, portBASE_TYPE xQueued )
+{
+xI2CRegisters *pxRegs = pxBus->pxPort->pxRegs;
+unsigned long ulHz;
+xI2CClientStats *pxClient;
+unsigned long ulWaitUs;
+
+	/* Run at the bus rate unless the slave is slower. */
+	ulHz = pxBus->ulBusHz;
+	if( ( pxTransaction->ulMaxHz != 0 ) && ( pxTransaction->ulMaxHz < ulHz ) )
+	{
+		ulHz = pxTransaction->ulMaxHz;
+	}
+	if( ulHz != pxBus->ulProgrammedHz )
+	{
+		prvSetClock( pxBus, ulHz );
+	}
+
+	pxBus->pxCurrent = pxTransaction;
+	pxBus->uxRetries = 0;
+	pxBus->ulPhaseCount++;
+	pxBus->ulStartUs = ulTimestampUs();
+	prvRewind( pxBus );
+
+	/* Charge the time spent queued to the client. */
+	if( pxTransaction->uxClient < i2cMAX_CLIENTS )
+	{
+		pxClient = &pxBus->xClientStats[ pxTransaction->uxClient ];
+		ulWaitUs = ulTimestampUs() - pxTransaction->ulSubmitUs;
+		pxClient->ulTransactions++;
+		if( xQueued == pdTRUE )
+		{
+			pxClient->ulContended++;
+		}
+		pxClient->ulTotalWaitUs += ulWaitUs;
+		if( ulWaitUs > pxClient->ulWorstWaitUs )
+		{
+			pxClient->ulWorstWaitUs = ulWaitUs;
+		}
+	}
+
+	if( xStopFirst == pdTRUE )
+	{
+		/* Setting STO and STA together sends the STOP, then a START. */
+		pxRegs->ulConSet = I2C_STO | I2C_STA;
+	}
+	else
+	{
+		/* Initialise and request send START.  Everything from here up to
+		the STOP is driven by the interrupt handler. */
+		pxRegs->ulConClr = I2C_AA | I2C_SI | I2C_STA | I2C_STO;
+		pxRegs->ulConSet = I2C_STA;
+	}
+}
+/*-----------------------------------------------------------*/
+
+portBASE_TYPE xI2CSubmit( xI2CTransaction *pxTransaction, portTickType xBlockTime )
+{
+xI2CBus *pxBus = &xBuses[ pxTransaction->uxBus ];
+portBASE_TYPE xReturn;
+portBASE_TYPE xWatchdogStarted = pdPASS;
+xI2CTransaction *pxNext;
+
+	pxTransaction->xStatus = i2cPENDING;
+	pxTransaction->ulSubmitUs = ulTimestampUs();
+
+	portENTER_CRITICAL();
+	{
+		if( pxBus->xBusBusy == pdFALSE )
+		{
+			/* The bus is idle so start the transaction directly. */
+			pxBus->xBusBusy = pdTRUE;
+			xWatchdogStarted = xTimerStart( pxBus->xWatchdog, 0 );
+			prvStartTransaction( pxBus, pxTransaction, pdFALSE, pdFALSE );
+			xReturn = pdPASS;
+		}
+		else
+		{
+			/* Queue it behind the running transaction.  It is ok to block
+			within a critical section as each task has its own critical
+			section management. */
+			xReturn = xQueueSend( pxBus->xSubmitQ, &pxTransaction, xBlockTime );
+
+			/* While we were blocked the interrupt handler may have drained
+			the queue and released the bus, in which case start the queue
+			off again. */
+			if( pxBus->xBusBusy == pdFALSE )
+			{
+				if( xQueueReceive( pxBus->xSubmitQ, &pxNext, 0 ) == pdTRUE )
+				{
+					pxBus->xBusBusy = pdTRUE;
+					xWatchdogStarted = xTimerStart( pxBus->xWatchdog, 0 );
+					prvStartTransaction( pxBus, pxNext, pdFALSE, pdTRUE );
+				}
+			}
+		}
+	}
+	portEXIT_CRITICAL();
+
+	/* A full timer command queue would leave the bus with no watchdog, so
+	wait for room now that interrupts are back on.  Should the transaction
+	finish first, the watchdog finds the bus idle and stops itself. */
+	if( xWatchdogStarted != pdPASS )
+	{
+		xTimerStart( pxBus->xWatchdog, portMAX_DELAY );
+	}
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+portBASE_TYPE xI2CTransfer( xI2CTransaction *pxTransaction )
+{
+xI2CTransaction *pxDone;
+
+	if( xI2CSubmit( pxTransaction, portMAX_DELAY ) != pdPASS )
+	{
+		return i2cBUS_ERROR;
+	}
+
+	/* Block until the interrupt handler reports completion. */
+	xQueueReceive( pxTransaction->xDoneQ, &pxDone, portMAX_DELAY );
+
+	return pxTransaction->xStatus;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSetPinsOutput( unsigned long ulPins, portBASE_TYPE xOutput )
+{
+	/* The other buses share IODIR0, so the read-modify-write must not be
+	interrupted. */
+	portENTER_CRITICAL();
+	{
+		if( xOutput == pdTRUE )
+		{
+			IODIR0 |= ulPins;
+		}
+		else
+		{
+			IODIR0 &= ~ulPins;
+		}
+	}
+	portEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+static void prvRecoverBus( xI2CBus *pxBus )
+{
+const xI2CPort *pxPort = pxBus->pxPort;
+unsigned long ulSDA = pxPort->ulSDAPin, ulSCL = pxPort->ulSCLPin;
+volatile unsigned long ulDelay;
+portBASE_TYPE x;
+
+	/* Take the pins away from the peripheral.  Not every bus has open
+	drain pins, so pull a line low by making it a low output and release
+	it by making it an input again. */
+	pxPort->pxRegs->ulConClr = I2C_AA | I2C_SI | I2C_STA | I2C_I2EN;
+	IOCLR0 = ulSDA | ulSCL;
+	portENTER_CRITICAL();
+	{
+		IODIR0 &= ~( ulSDA | ulSCL );
+		*pxPort->pulPinSel &= ~pxPort->ulPinSelMask;
+	}
+	portEXIT_CRITICAL();
+
+	/* Clock SCL until the slave lets go of SDA. */
+	for( x = 0; ( x < i2cRECOVERY_CLOCKS ) && !( IOPIN0 & ulSDA ); x++ )
+	{
+		prvSetPinsOutput( ulSCL, pdTRUE );
+		for( ulDelay = 0; ulDelay < i2cRECOVERY_DELAY; ulDelay++ );
+		prvSetPinsOutput( ulSCL, pdFALSE );
+		for( ulDelay = 0; ulDelay < i2cRECOVERY_DELAY; ulDelay++ );
+	}
+
+	/* STOP: SDA rises while SCL is high. */
+	prvSetPinsOutput( ulSCL, pdTRUE );
+	for( ulDelay = 0; ulDelay < i2cRECOVERY_DELAY; ulDelay++ );
+	prvSetPinsOutput( ulSDA, pdTRUE );
+	for( ulDelay = 0; ulDelay < i2cRECOVERY_DELAY; ulDelay++ );
+	prvSetPinsOutput( ulSCL, pdFALSE );
+	for( ulDelay = 0; ulDelay < i2cRECOVERY_DELAY; ulDelay++ );
+	prvSetPinsOutput( ulSDA, pdFALSE );
+	for( ulDelay = 0; ulDelay < i2cRECOVERY_DELAY; ulDelay++ );
+
+	/* Hand the pins back and restart the peripheral. */
+	portENTER_CRITICAL();
+	{
+		*pxPort->pulPinSel |= pxPort->ulPinSelI2C;
+	}
+	portEXIT_CRITICAL();
+	pxPort->pxRegs->ulConSet = I2C_I2EN;
+}
+/*-----------------------------------------------------------*/
+
+static void prvWatchdog( xTimerHandle xTimer )
+{
+xI2CBus *pxBus = ( xI2CBus * ) pvTimerGetTimerID( xTimer );
+portBASE_TYPE xStuck = pdFALSE;
+
+	portENTER_CRITICAL();
+	{
+		if( ( pxBus->xBusBusy == pdTRUE ) && ( pxBus->xAbortPending == pdFALSE ) && ( pxBus->ulPhaseCount == pxBus->ulWatchdogCount ) )
+		{
+			/* No interrupt since the last check, so the current phase has
+			missed its deadline.  Mask the bus's interrupt while it is
+			freed; everything else keeps running. */
+			xStuck = pdTRUE;
+			VICIntEnClr = pxBus->pxPort->ulVICChannelBit;
+		}
+		else if( pxBus->xBusBusy == pdFALSE )
+		{
+			/* The interrupt handler stops the timer when the bus goes
+			idle, this only catches a stop command lost to a full timer
+			queue. */
+			xTimerStop( xTimer, 0 );
+		}
+		pxBus->ulWatchdogCount = pxBus->ulPhaseCount;
+	}
+	portEXIT_CRITICAL();
+
+	if( xStuck == pdTRUE )
+	{
+		/* Free the bus with interrupts enabled, then let the interrupt
+		handler complete the transaction and start the next one. */
+		prvRecoverBus( pxBus );
+
+		portENTER_CRITICAL();
+		{
+			pxBus->xStats.ulRecoveries++;
+			pxBus->xAbortPending = pdTRUE;
+			VICSoftInt = pxBus->pxPort->ulVICChannelBit;
+			VICIntEnable |= pxBus->pxPort->ulVICChannelBit;
+		}
+		portEXIT_CRITICAL();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vI2CGetStats( unsigned portBASE_TYPE uxBus, xI2CStats *pxStats )
+{
+	portENTER_CRITICAL();
+	{
+		*pxStats = xBuses[ uxBus ].xStats;
+	}
+	portEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+void vI2CGetClientStats( unsigned portBASE_TYPE uxBus, unsigned portBASE_TYPE uxClient, xI2CClientStats *pxStats )
+{
+	portENTER_CRITICAL();
+	{
+		*pxStats = xBuses[ uxBus ].xClientStats[ uxClient ];
+	}
+	portEXIT_CRITICAL();
+}
+/*-----------------------------------------------------------*/
+
+void vI2C0_ISRHandler( void )
+{
+	prvHandleInterrupt( &xBuses[ i2cBUS0 ] );
+}
+/*-----------------------------------------------------------*/
+
+void vI2C1_ISRHandler( void )
+{
+	prvHandleInterrupt( &xBuses[ i2cBUS1 ] );
+}
+/*-----------------------------------------------------------*/
+
+void vI2C2_ISRHandler( void )
+{
+	prvHandleInterrupt( &xBuses[ i2cBUS2 ] );
+}
+/*-----------------------------------------------------------*/
+
+static void prvHandleInterrupt( xI2CBus *pxBus )
+{
+xI2CRegisters *pxRegs = pxBus->pxPort->pxRegs;
+xI2CTransaction *pxCurrent = pxBus->pxCurrent;
+portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+portBASE_TYPE xFinished = pdFALSE;
+portBASE_TYPE xStatus = i2cOK;
+xI2CTransaction *pxDone, *pxNext;
+unsigned long ulLatencyUs;
+unsigned long ulNowUs;
+unsigned char ucStat;
+unsigned long ulClear = I2C_SI;
+
+	pxBus->ulPhaseCount++;
+
+	if( pxBus->xAbortPending == pdTRUE )
+	{
+		/* Raised by the watchdog after a bus recovery. */
+		VICSoftIntClear = pxBus->pxPort->ulVICChannelBit;
+		pxBus->xAbortPending = pdFALSE;
+		ucStat = i2cSTAT_ABORT;
+
+		/* The peripheral has been reset, so SI is not set. */
+		ulClear = 0;
+	}
+	else
+	{
+		ucStat = ( unsigned char ) pxRegs->ulStat;
+	}
+
+	switch( ucStat )
+	{
+		case i2cSTAT_START :		/* Send the address with R/W bit.  Once
+									the write phase is done (or if there is
+									nothing to write) this START opens the
+									read phase. */
+									if( pxBus->uxXferWriteLen > 0 )
+									{
+										pxRegs->ulDat = pxCurrent->ucAddress;
+									}
+									else
+									{
+										pxRegs->ulDat = pxCurrent->ucAddress | i2cREAD;
+									}
+									ulClear |= I2C_STA;
+									break;
+
+		case i2cSTAT_REP_START :	/* Switch to the read phase. */
+									pxRegs->ulDat = pxCurrent->ucAddress | i2cREAD;
+									ulClear |= I2C_STA;
+									break;
+
+		case i2cSTAT_SLAW_ACK :
+		case i2cSTAT_DATA_TX_ACK :	/* Send the next byte, turn the bus
+									round for the read phase or finish. */
+									if( pxBus->uxXferWriteLen > 0 )
+									{
+										pxRegs->ulDat = *pxBus->pucXferWrite++;
+										pxBus->uxXferWriteLen--;
+									}
+									else if( pxBus->uxXferReadLen > 0 )
+									{
+										if( pxCurrent->xRepeatedStart == pdTRUE )
+										{
+											pxRegs->ulConSet = I2C_STA;
+										}
+										else
+										{
+											pxRegs->ulConSet = I2C_STO | I2C_STA;
+										}
+									}
+									else
+									{
+										pxRegs->ulConSet = I2C_STO;
+										xFinished = pdTRUE;
+									}
+									break;
+
+		case i2cSTAT_SLAR_ACK :		/* ACK every byte but the last. */
+									if( pxBus->uxXferReadLen > 1 )
+									{
+										pxRegs->ulConSet = I2C_AA;
+									}
+									else
+									{
+										ulClear |= I2C_AA;
+									}
+									break;
+
+		case i2cSTAT_DATA_RX_ACK :	*pxBus->pucXferRead++ = ( unsigned char ) pxRegs->ulDat;
+									pxBus->uxXferReadLen--;
+									if( pxBus->uxXferReadLen > 1 )
+									{
+										pxRegs->ulConSet = I2C_AA;
+									}
+									else
+									{
+										ulClear |= I2C_AA;
+									}
+									break;
+
+		case i2cSTAT_DATA_RX_NACK :	/* Last byte received, send STOP. */
+									*pxBus->pucXferRead++ = ( unsigned char ) pxRegs->ulDat;
+									pxBus->uxXferReadLen--;
+									pxRegs->ulConSet = I2C_STO;
+									xFinished = pdTRUE;
+									break;
+
+		case i2cSTAT_SLAW_NACK :
+		case i2cSTAT_DATA_TX_NACK :
+		case i2cSTAT_SLAR_NACK :	/* The slave did not answer. */
+									xStatus = i2cNACK;
+									pxBus->xStats.ulNacks++;
+									pxRegs->ulConSet = I2C_STO;
+									xFinished = pdTRUE;
+									break;
+
+		case i2cSTAT_ARB_LOST :		/* Another master won the bus.  Start
+									again from the top once it is free. */
+									if( pxBus->uxRetries < i2cMAX_RETRIES )
+									{
+										pxBus->uxRetries++;
+										pxBus->xStats.ulArbitrationRetries++;
+										prvRewind( pxBus );
+										pxRegs->ulConSet = I2C_STA;
+									}
+									else
+									{
+										xStatus = i2cARB_LOST;
+										xFinished = pdTRUE;
+									}
+									break;
+
+		case i2cSTAT_ABORT :		/* The bus has already been recovered. */
+									xStatus = i2cTIMEOUT;
+									pxBus->xStats.ulTimeouts++;
+									xFinished = pdTRUE;
+									break;
+
+		case i2cSTAT_BUS_ERROR :
+		default :					/* Release the bus. */
+									xStatus = i2cBUS_ERROR;
+									pxRegs->ulConSet = I2C_STO;
+									xFinished = pdTRUE;
+									break;
+	}
+
+	if( xFinished == pdTRUE )
+	{
+		pxDone = pxCurrent;
+		pxDone->xStatus = xStatus;
+
+		ulNowUs = ulTimestampUs();
+		vI2CTraceAdd( pxDone->uxBus, pxDone, pxBus->ulStartUs, ulNowUs );
+
+		pxBus->xStats.ulTransactions++;
+		pxBus->xStats.ulBusyUs += ulNowUs - pxBus->ulStartUs;
+		ulLatencyUs = ulNowUs - pxDone->ulSubmitUs;
+		if( ulLatencyUs > pxBus->xStats.ulWorstLatencyUs )
+		{
+			pxBus->xStats.ulWorstLatencyUs = ulLatencyUs;
+		}
+
+		/* Chain the next queued transaction straight onto the STOP.  After
+		an abort the peripheral is idle, so it needs a plain START. */
+		if( xQueueReceiveFromISR( pxBus->xSubmitQ, &pxNext, &xHigherPriorityTaskWoken ) == pdTRUE )
+		{
+			prvStartTransaction( pxBus, pxNext, ( ucStat == i2cSTAT_ABORT ) ? pdFALSE : pdTRUE, pdTRUE );
+		}
+		else
+		{
+			pxBus->xBusBusy = pdFALSE;
+			xTimerStopFromISR( pxBus->xWatchdog, &xHigherPriorityTaskWoken );
+		}
+
+		if( pxDone->xDoneQ != NULL )
+		{
+			xQueueSendFromISR( pxDone->xDoneQ, &pxDone, &xHigherPriorityTaskWoken );
+		}
+	}
+
+	/* Let the state machine move on.  The bits to clear go out in one
+	write together with SI, so the peripheral sees them before it starts
+	the next phase. */
+	if( ulClear != 0 )
+	{
+		pxRegs->ulConClr = ulClear;
+	}
+
+	/* Clear the ISR in the VIC. */
+	VICVectAddr = 0;
+
+	/* Exit the ISR.  If the task waiting for the transfer was woken then a
+	context switch will occur. */
+	portEXIT_SWITCHING_ISR( xHigherPriorityTaskWoken );
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,117 @@
+#ifndef I2C_H
+#define I2C_H
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+/* Transaction completion codes */
+#define i2cOK				( ( portBASE_TYPE ) 0 )
+#define i2cNACK				( ( portBASE_TYPE ) 1 )
+#define i2cBUS_ERROR		( ( portBASE_TYPE ) 2 )
+#define i2cARB_LOST			( ( portBASE_TYPE ) 3 )
+#define i2cTIMEOUT			( ( portBASE_TYPE ) 4 )
+
+/* Transaction status while it is queued or on the bus */
+#define i2cPENDING			( ( portBASE_TYPE ) -1 )
+
+/* Bus clock rates */
+#define i2cSTANDARD_MODE_HZ	( ( unsigned long ) 100000 )
+#define i2cFAST_MODE_HZ		( ( unsigned long ) 400000 )
+
+/* Buses, for xI2CTransaction.uxBus */
+#define i2cBUS0				( ( unsigned portBASE_TYPE ) 0 )
+#define i2cBUS1				( ( unsigned portBASE_TYPE ) 1 )
+#define i2cBUS2				( ( unsigned portBASE_TYPE ) 2 )
+#define i2cNUM_BUSES		3
+
+/* Maximum number of transactions waiting for each bus */
+#define i2cQUEUE_LENGTH		( ( unsigned portBASE_TYPE ) 8 )
+
+/* Number of client IDs the driver keeps wait statistics for, per bus */
+#define i2cMAX_CLIENTS		( ( unsigned portBASE_TYPE ) 4 )
+
+/*
+ * One I2C transaction: write uxWriteLen bytes to the slave at ucAddress
+ * (8-bit form, R/W bit clear) on bus uxBus, then read uxReadLen bytes back.  Between the
+ * two phases the master issues a repeated START if xRepeatedStart is pdTRUE,
+ * otherwise a STOP followed by a new START.
+ *
+ * Transactions on a bus are run strictly in submission order, so the driver
+ * is the only owner of the bus registers.  Each bus runs independently of
+ * the others.  uxClient (0 to i2cMAX_CLIENTS - 1)
+ * says who the transaction is for; the time it spends queued behind other
+ * transactions is charged to that client.
+ *
+ * ulMaxHz is the fastest SCL rate the slave supports, or 0 for no limit.
+ * The transaction runs at the lower of this and the bus rate.
+ *
+ * When the transaction finishes the driver sets xStatus and, if xDoneQ is not
+ * NULL, posts a pointer to the transaction to xDoneQ.  The descriptor and the
+ * buffers it points at must stay valid until then.
+ */
+typedef struct I2C_TRANSACTION
+{
+	unsigned portBASE_TYPE uxBus;
+	unsigned char ucAddress;
+	const unsigned char *pucWrite;
+	unsigned portBASE_TYPE uxWriteLen;
+	unsigned char *pucRead;
+	unsigned portBASE_TYPE uxReadLen;
+	portBASE_TYPE xRepeatedStart;
+	unsigned long ulMaxHz;
+	unsigned portBASE_TYPE uxClient;
+	xQueueHandle xDoneQ;
+	volatile portBASE_TYPE xStatus;
+	unsigned long ulSubmitUs;			/* set by the driver, from ulTimestampUs() */
+} xI2CTransaction;
+
+/* Driver counters, per bus */
+typedef struct I2C_STATS
+{
+	unsigned long ulTransactions;		/* transactions completed */
+	unsigned long ulNacks;				/* address or data not acknowledged */
+	unsigned long ulArbitrationRetries;	/* STARTs reissued after losing arbitration */
+	unsigned long ulTimeouts;			/* transactions aborted by a phase deadline */
+	unsigned long ulRecoveries;			/* bus recovery sequences run */
+	unsigned long ulWorstLatencyUs;		/* longest submit to completion time */
+	unsigned long ulBusyUs;				/* microseconds spent running transactions, summed; wraps */
+} xI2CStats;
+
+/* Bus contention seen by one client */
+typedef struct I2C_CLIENT_STATS
+{
+	unsigned long ulTransactions;		/* transactions started */
+	unsigned long ulContended;			/* transactions that had to queue */
+	unsigned long ulTotalWaitUs;		/* microseconds spent queued, summed; wraps */
+	unsigned long ulWorstWaitUs;		/* longest time spent queued */
+} xI2CClientStats;
+
+/*
+ * Power up and start one bus.  Calling it again for a bus that is already
+ * running does nothing, so each device can init the bus it is on.
+ */
+void vI2CInit( unsigned portBASE_TYPE uxBus );
+
+/*
+ * Set a bus's SCL rate, e.g. i2cSTANDARD_MODE_HZ or i2cFAST_MODE_HZ.  Takes
+ * effect from the next transaction.
+ */
+void vI2CSetSpeed( unsigned portBASE_TYPE uxBus, unsigned long ulHz );
+
+/*
+ * Queue a transaction for the bus and return without waiting for it to run.
+ * Blocks for at most xBlockTime only if the submission queue is full.
+ */
+portBASE_TYPE xI2CSubmit( xI2CTransaction *pxTransaction, portTickType xBlockTime );
+
+/*
+ * Submit a transaction and block until it completes.  xDoneQ must be a
+ * completion queue private to the caller, holding at least one
+ * xI2CTransaction pointer.  Returns the completion code.
+ */
+portBASE_TYPE xI2CTransfer( xI2CTransaction *pxTransaction );
+
+void vI2CGetStats( unsigned portBASE_TYPE uxBus, xI2CStats *pxStats );
+void vI2CGetClientStats( unsigned portBASE_TYPE uxBus, unsigned portBASE_TYPE uxClient, xI2CClientStats *pxStats );
+
+#endif
@@ -0,0 +1,64 @@
+; These are the LPC2468 platform-specific interrupt handlers for
+; I2C0, I2C1 and I2C2 interrupts. Each simply saves the context of the
+; current task, calls the real interrupt handler for its bus and then
+; restores the context of the next task, which may be different
+; from the task that was running when the interrupt occurred.
+
+	INCLUDE portmacro.inc
+
+	IMPORT vI2C0_ISRHandler
+	IMPORT vI2C1_ISRHandler
+	IMPORT vI2C2_ISRHandler
+	EXPORT vI2C0_ISREntry
+	EXPORT vI2C1_ISREntry
+	EXPORT vI2C2_ISREntry
+
+	;/* Interrupt entry must always be in ARM mode. */
+	ARM
+	AREA	|.text|, CODE, READONLY
+
+
+vI2C0_ISREntry
+
+	PRESERVE8
+
+	; Save the context of the interrupted task.
+	portSAVE_CONTEXT
+
+	; Call the C handler function - defined within i2c.c.
+	LDR R0, =vI2C0_ISRHandler
+	MOV LR, PC
+	BX R0
+
+	; Finish off by restoring the context of the task that has been chosen to
+	; run next - which might be a different task to that which was originally
+	; interrupted.
+	portRESTORE_CONTEXT
+
+
+vI2C1_ISREntry
+
+	PRESERVE8
+
+	portSAVE_CONTEXT
+
+	LDR R0, =vI2C1_ISRHandler
+	MOV LR, PC
+	BX R0
+
+	portRESTORE_CONTEXT
+
+
+vI2C2_ISREntry
+
+	PRESERVE8
+
+	portSAVE_CONTEXT
+
+	LDR R0, =vI2C2_ISRHandler
+	MOV LR, PC
+	BX R0
+
+	portRESTORE_CONTEXT
+
+	END
@@ -0,0 +1,198 @@
+/*
+	Always-on I2C transaction tracer.
+
+	The I2C driver reports every transaction as it completes.  The last
+	i2ctraceRING_LENGTH of them are kept in a RAM ring, and each device gets
+	a histogram of its bus time, so slow devices and a saturated bus can be
+	seen from the console without a logic analyser.
+
+	Records are only added from the I2C interrupt handlers, which share a
+	priority and do not nest, so adding needs no locking.  Readers copy
+	inside a critical section.
+*/
+
+#include <stdio.h>
+
+/* Scheduler includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "i2c.h"
+#include "i2ctrace.h"
+
+/*-----------------------------------------------------------*/
+
+#define i2ctraceRING_MASK		( i2ctraceRING_LENGTH - 1 )
+
+/*-----------------------------------------------------------*/
+
+/* The ring and the number of records ever added to it. */
+static xI2CTraceRecord xRing[ i2ctraceRING_LENGTH ];
+static unsigned long ulAdded;
+
+/* Histograms in the order devices were first seen. */
+static xI2CTraceHistogram xHistograms[ i2ctraceMAX_DEVICES ];
+static unsigned portBASE_TYPE uxDevices;
+static unsigned long ulUntracked;
+
+/* Snapshot for printing, too big for the console task's stack. */
+static xI2CTraceRecord xPrintCopy[ i2ctraceRING_LENGTH ];
+
+/*-----------------------------------------------------------*/
+
+void vI2CTraceAdd( unsigned portBASE_TYPE uxBus, const xI2CTransaction *pxTransaction, unsigned long ulStart, unsigned long ulEnd )
+{
+xI2CTraceRecord *pxRecord;
+xI2CTraceHistogram *pxHistogram = NULL;
+unsigned long ulUs, ulLimit;
+unsigned portBASE_TYPE ux;
+
+	pxRecord = &xRing[ ulAdded & i2ctraceRING_MASK ];
+	pxRecord->ulStart = ulStart;
+	pxRecord->ulEnd = ulEnd;
+	pxRecord->ucBus = ( unsigned char ) uxBus;
+	pxRecord->ucAddress = pxTransaction->ucAddress;
+	pxRecord->ucLength = ( unsigned char ) ( pxTransaction->uxWriteLen + pxTransaction->uxReadLen );
+	pxRecord->cStatus = ( signed char ) pxTransaction->xStatus;
+	ulAdded++;
+
+	/* Find the device, or give it the next free histogram. */
+	for( ux = 0; ux < uxDevices; ux++ )
+	{
+		if( ( xHistograms[ ux ].ucBus == uxBus ) && ( xHistograms[ ux ].ucAddress == pxTransaction->ucAddress ) )
+		{
+			pxHistogram = &xHistograms[ ux ];
+			break;
+		}
+	}
+	if( pxHistogram == NULL )
+	{
+		if( uxDevices >= i2ctraceMAX_DEVICES )
+		{
+			ulUntracked++;
+			return;
+		}
+		pxHistogram = &xHistograms[ uxDevices++ ];
+		pxHistogram->ucBus = ( unsigned char ) uxBus;
+		pxHistogram->ucAddress = pxTransaction->ucAddress;
+	}
+
+	ulUs = ulEnd - ulStart;
+	pxHistogram->ulCount++;
+	if( pxTransaction->xStatus != i2cOK )
+	{
+		pxHistogram->ulErrors++;
+	}
+	if( ulUs > pxHistogram->ulMaxUs )
+	{
+		pxHistogram->ulMaxUs = ulUs;
+	}
+
+	ulLimit = i2ctraceFIRST_BIN_US;
+	for( ux = 0; ( ux < i2ctraceNUM_BINS - 1 ) && ( ulUs >= ulLimit ); ux++ )
+	{
+		ulLimit <<= 1;
+	}
+	pxHistogram->ulBins[ ux ]++;
+}
+/*-----------------------------------------------------------*/
+
+unsigned portBASE_TYPE uxI2CTraceRead( xI2CTraceRecord *pxRecords, unsigned portBASE_TYPE uxMax )
+{
+unsigned portBASE_TYPE uxCount, ux;
+unsigned long ulFirst;
+
+	if( uxMax > i2ctraceRING_LENGTH )
+	{
+		uxMax = i2ctraceRING_LENGTH;
+	}
+
+	portENTER_CRITICAL();
+	{
+		uxCount = ( ulAdded < uxMax ) ? ( unsigned portBASE_TYPE ) ulAdded : uxMax;
+		ulFirst = ulAdded - uxCount;
+		for( ux = 0; ux < uxCount; ux++ )
+		{
+			pxRecords[ ux ] = xRing[ ( ulFirst + ux ) & i2ctraceRING_MASK ];
+		}
+	}
+	portEXIT_CRITICAL();
+
+	return uxCount;
+}
+/*-----------------------------------------------------------*/
+
+portBASE_TYPE xI2CTraceGetHistogram( unsigned portBASE_TYPE uxIndex, xI2CTraceHistogram *pxHistogram )
+{
+portBASE_TYPE xReturn = pdFALSE;
+
+	portENTER_CRITICAL();
+	{
+		if( uxIndex < uxDevices )
+		{
+			*pxHistogram = xHistograms[ uxIndex ];
+			xReturn = pdTRUE;
+		}
+	}
+	portEXIT_CRITICAL();
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+unsigned long ulI2CTraceUntracked( void )
+{
+	return ulUntracked;
+}
+/*-----------------------------------------------------------*/
+
+void vI2CTracePrintHistograms( void )
+{
+xI2CTraceHistogram xHistogram;
+unsigned portBASE_TYPE uxDevice, ux;
+unsigned long ulLimit;
+
+	printf("I2C bus time per device, count by upper bound in us\r\n");
+	printf("bus addr    count errors    max");
+	for( ux = 0, ulLimit = i2ctraceFIRST_BIN_US; ux < i2ctraceNUM_BINS - 1; ux++, ulLimit <<= 1 )
+	{
+		printf(" %6lu", ulLimit);
+	}
+	printf("   more\r\n");
+
+	for( uxDevice = 0; xI2CTraceGetHistogram( uxDevice, &xHistogram ) == pdTRUE; uxDevice++ )
+	{
+		printf("%3u 0x%02X %8lu %6lu %6lu", ( unsigned ) xHistogram.ucBus, ( unsigned ) xHistogram.ucAddress,
+			xHistogram.ulCount, xHistogram.ulErrors, xHistogram.ulMaxUs);
+		for( ux = 0; ux < i2ctraceNUM_BINS; ux++ )
+		{
+			printf(" %6lu", xHistogram.ulBins[ ux ]);
+		}
+		printf("\r\n");
+	}
+
+	if( ulUntracked != 0 )
+	{
+		printf("%lu transactions from untracked devices\r\n", ulUntracked);
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vI2CTracePrintRing( void )
+{
+unsigned portBASE_TYPE uxCount, ux;
+xI2CTraceRecord *pxRecord;
+
+	uxCount = uxI2CTraceRead( xPrintCopy, i2ctraceRING_LENGTH );
+
+	printf("     start(us)  gap(us) time(us) bus addr len status\r\n");
+	for( ux = 0; ux < uxCount; ux++ )
+	{
+		pxRecord = &xPrintCopy[ ux ];
+		printf("%14lu %8lu %8lu %3u 0x%02X %3u %d\r\n", pxRecord->ulStart,
+			( ux == 0 ) ? 0UL : pxRecord->ulStart - xPrintCopy[ ux - 1 ].ulStart,
+			pxRecord->ulEnd - pxRecord->ulStart, ( unsigned ) pxRecord->ucBus,
+			( unsigned ) pxRecord->ucAddress, ( unsigned ) pxRecord->ucLength, ( int ) pxRecord->cStatus);
+	}
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,69 @@
+#ifndef I2C_TRACE_H
+#define I2C_TRACE_H
+
+#include "FreeRTOS.h"
+#include "i2c.h"
+
+/* Transactions kept in the trace ring, a power of two */
+#define i2ctraceRING_LENGTH		64
+
+/* Devices (bus and address pairs) with their own latency histogram */
+#define i2ctraceMAX_DEVICES		8
+
+/* Histogram bins.  Bin 0 counts transactions under i2ctraceFIRST_BIN_US
+and each bin after it covers twice the time of the one before; the last
+bin also counts everything longer. */
+#define i2ctraceNUM_BINS		10
+#define i2ctraceFIRST_BIN_US	( ( unsigned long ) 64 )
+
+/* One finished transaction.  Times are microseconds from ulTimestampUs(),
+from the first START to completion. */
+typedef struct I2C_TRACE_RECORD
+{
+	unsigned long ulStart;
+	unsigned long ulEnd;
+	unsigned char ucBus;
+	unsigned char ucAddress;
+	unsigned char ucLength;			/* bytes written plus bytes read */
+	signed char cStatus;			/* i2cOK etc. */
+} xI2CTraceRecord;
+
+/* Bus time seen by one device */
+typedef struct I2C_TRACE_HISTOGRAM
+{
+	unsigned char ucBus;
+	unsigned char ucAddress;
+	unsigned long ulCount;
+	unsigned long ulErrors;
+	unsigned long ulMaxUs;
+	unsigned long ulBins[ i2ctraceNUM_BINS ];
+} xI2CTraceHistogram;
+
+/*
+ * Called by the I2C driver from its interrupt handlers as each transaction
+ * completes.
+ */
+void vI2CTraceAdd( unsigned portBASE_TYPE uxBus, const xI2CTransaction *pxTransaction, unsigned long ulStart, unsigned long ulEnd );
+
+/*
+ * Copy out the most recent records, oldest first.  Returns the number
+ * copied, at most uxMax.
+ */
+unsigned portBASE_TYPE uxI2CTraceRead( xI2CTraceRecord *pxRecords, unsigned portBASE_TYPE uxMax );
+
+/*
+ * Copy out the histogram of device uxIndex (0 to i2ctraceMAX_DEVICES - 1).
+ * Returns pdFALSE once uxIndex is past the last device seen.
+ */
+portBASE_TYPE xI2CTraceGetHistogram( unsigned portBASE_TYPE uxIndex, xI2CTraceHistogram *pxHistogram );
+
+/* Transactions not counted because the device table was full */
+unsigned long ulI2CTraceUntracked( void );
+
+/*
+ * Print the histograms, or the trace ring, to the console.
+ */
+void vI2CTracePrintHistograms( void );
+void vI2CTracePrintRing( void );
+
+#endif
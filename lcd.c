@@ -16,6 +16,9 @@
 #include <stdio.h>
 #include <string.h>
 #include "controller.h"
+#include "event.h"
+#include "statemachine.h"
+#include "mytimer.h"
 
 /* Maximum task stack size */
 #define lcdSTACK_SIZE			( ( unsigned portBASE_TYPE ) 256 )
@@ -30,16 +33,25 @@ static void vLcdTask( void *pvParameters );
 /* my assignment code */
 extern xComPortHandle xConsolePortHandle(void);
 
-extern const ulong PASSWORD_APPROVED;
 static xQueueHandle xTouchScreenPressedQ;
-extern xQueueHandle xGlobalStateQueueQ;
 extern const portTickType TICKS_TO_WAIT;
 
+/* controller state last drawn */
+static unsigned long drawnVersion;
+
+/* the controller changed state: wake the task as if the screen was
+ * touched, it checks for both */
+static void doorsChanged(unsigned long version)
+{
+	xQueueSend(xTouchScreenPressedQ, NULL, 0);
+}
+
 void vStartLcd( unsigned portBASE_TYPE uxPriority )
 {
 	/* my assignment code */
 	// create a message queque
 	xTouchScreenPressedQ = xQueueCreate(1,0);		
+	addControllerListener(doorsChanged);
 
 	/* Spawn the console task . */
 	xTaskCreate( vLcdTask, ( signed char * ) "Lcd", lcdSTACK_SIZE, NULL, uxPriority, ( xTaskHandle * ) NULL );
@@ -102,6 +114,27 @@ void changeButtonColorUsingButtonIndex(struct ButtonRectangle rect, unsigned cha
 	drawStringOnButtonUsingButtonIndex(rect, str);
 }
 
+/* show the keypad's airlock (0) door states in the strip above the
+ * buttons, if they changed since last drawn */
+void drawDoors(int height)
+{
+	struct ControllerState state;
+	char line[40];
+
+	getControllerState(&state);
+	if(state.version == drawnVersion)
+	{
+		return;
+	}
+	drawnVersion = state.version;
+
+	sprintf(line, "outer %s, inner %s",
+		doorStatus(state.state[0], state.unlocked[0], OUTER_DOOR),
+		doorStatus(state.state[0], state.unlocked[0], INNER_DOOR));
+	lcd_fillRect(0, 0, DISPLAY_WIDTH-1, height-1, BLACK);
+	lcd_putString(4, (height-8)/2, (unsigned char *) line);
+}
+
 int checkPassword(const short digit[], const short password[], int len)
 {
 	int i;
@@ -208,6 +241,9 @@ static portTASK_FUNCTION( vLcdTask, pvParameters )
 		y_pos += block_height + line_border;
 	}
 
+	drawnVersion = ~0UL;
+	drawDoors(line_border);
+
 	/* Infinite loop blocks waiting for a touch screen interrupt event from
 	 * the queue. */
 	for( ;; )
@@ -223,6 +259,9 @@ static portTASK_FUNCTION( vLcdTask, pvParameters )
 		
 		/* Disable TS interrupt vector (VIC) (vector 17) */
 		VICIntEnClr = 1 << 17;
+
+		/* the wake up may have been the controller, not a touch */
+		drawDoors(line_border);
 						
 		/* +++ This point in the code can be interpreted as a screen button push event +++ */
 		/* Start polling the touchscreen pressure and position ( getTouch(...) ) */
@@ -267,8 +306,7 @@ static portTASK_FUNCTION( vLcdTask, pvParameters )
 								// password is valid, send message to queue
 								printf("Password correct\r\n");
 								printf("\r\n");
-								xQueueSend(xGlobalStateQueueQ, &PASSWORD_APPROVED, TICKS_TO_WAIT);
-								// sendToGlobalQueue(PASSWORD_APPROVED);
+								sendEvent(PASSWORD_APPROVED, SOURCE_KEYPAD, 0, ulTimestampUs());	/* keypad is at airlock 0 */
 							}
 							else
 							{
@@ -0,0 +1,113 @@
+/* Deferred logging for the controller.  Writing a line stores a format
+ * pointer and its raw arguments in a ring, which takes a few cycles; the
+ * drain task formats and prints them later at low priority, so the UART
+ * never holds up a state transition. */
+#include <stdio.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "mytimer.h"
+#include "log.h"
+#include "staticassert.h"
+
+#define logSTACK_SIZE			( ( unsigned portBASE_TYPE ) 256 )
+
+/* a ring length that is not a power of two does not compile */
+STATIC_ASSERT((LOG_RING_LENGTH & (LOG_RING_LENGTH - 1)) == 0, logRingIsPowerOfTwo);
+
+/* records written but not yet printed are ring[tail] up to ring[head - 1].
+ * Only logWrite() moves head and only the drain task moves tail, each after
+ * it is done with the record, so neither side needs a lock.  Both count up
+ * and wrap, and are masked to index the ring */
+static volatile struct LogRecord ring[LOG_RING_LENGTH];
+static volatile unsigned long head;
+static volatile unsigned long tail;
+
+/* written only by logWrite() */
+static volatile struct LogStats logStats;
+
+static void vLogTask(void *pvParameters);
+
+void vStartLog( unsigned portBASE_TYPE uxPriority )
+{
+	xTaskCreate( vLogTask, ( signed char * )"Log", logSTACK_SIZE, NULL, uxPriority, ( xTaskHandle * ) NULL);
+}
+
+void logWrite(const char *format, unsigned long a, unsigned long b)
+{
+	unsigned long depth = head - tail;
+	volatile struct LogRecord *record;
+
+	if(depth >= LOG_RING_LENGTH)
+	{
+		logStats.dropped++;
+		return;
+	}
+
+	record = &ring[head & (LOG_RING_LENGTH - 1)];
+	record->format = format;
+	record->timestamp = ulTimestampUs();
+	record->arg[0] = a;
+	record->arg[1] = b;
+
+	/* publish the record only once it is complete */
+	head++;
+
+	logStats.written++;
+	if(depth + 1 > logStats.deepest)
+	{
+		logStats.deepest = depth + 1;
+	}
+}
+
+void getLogStats(struct LogStats *stats)
+{
+	vTaskSuspendAll();
+	stats->written = logStats.written;
+	stats->dropped = logStats.dropped;
+	stats->deepest = logStats.deepest;
+	xTaskResumeAll();
+}
+
+void vPrintLog(void)
+{
+	struct LogStats stats;
+
+	getLogStats(&stats);
+	printf("log written %lu, dropped %lu, deepest %lu of %d, waiting %lu\r\n",
+		stats.written, stats.dropped, stats.deepest, LOG_RING_LENGTH, head - tail);
+}
+
+static portTASK_FUNCTION(vLogTask, pvParameters)
+{
+	struct LogRecord record;
+	volatile struct LogRecord *slot;
+	unsigned long reported = 0;
+
+	while(1)
+	{
+		while(tail != head)
+		{
+			slot = &ring[tail & (LOG_RING_LENGTH - 1)];
+			record.format = slot->format;
+			record.timestamp = slot->timestamp;
+			record.arg[0] = slot->arg[0];
+			record.arg[1] = slot->arg[1];
+
+			/* hand the slot back before the slow part */
+			tail++;
+
+			printf("%10lu ", record.timestamp);
+			printf(record.format, record.arg[0], record.arg[1]);
+			printf("\r\n");
+		}
+
+		/* say so when lines went missing, where they would have been */
+		if(logStats.dropped != reported)
+		{
+			printf("log: %lu lines dropped\r\n", logStats.dropped - reported);
+			reported = logStats.dropped;
+		}
+
+		vTaskDelay(LOG_DRAIN_TICKS);
+	}
+}
@@ -0,0 +1,41 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include "FreeRTOS.h"
+
+/* records the ring can hold, a power of two */
+#define LOG_RING_LENGTH			32
+
+/* how long the drain task sleeps when the ring is empty */
+#define LOG_DRAIN_TICKS			( ( portTickType ) 10 / portTICK_RATE_MS )
+
+/* one log line, not yet formatted.  The format is a string literal, so the
+ * pointer is its ID; the drain task prints it with the two arguments */
+struct LogRecord
+{
+	const char *format;
+	unsigned long timestamp;	/* ulTimestampUs() when it was written */
+	unsigned long arg[2];
+};
+
+struct LogStats
+{
+	unsigned long written;
+	unsigned long dropped;		/* ring was full */
+	unsigned long deepest;		/* most records waiting at once */
+};
+
+void vStartLog( unsigned portBASE_TYPE uxPriority );
+
+/* queue a line for the drain task without waiting or locking.  Only the
+ * controller task may call this: the ring has one writer and one reader.
+ * format must be a string literal taking at most two integer arguments,
+ * and no line ending */
+void logWrite(const char *format, unsigned long a, unsigned long b);
+
+void getLogStats(struct LogStats *stats);
+
+/* print the counters to the console */
+void vPrintLog(void);
+
+#endif
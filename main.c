@@ -11,7 +11,9 @@
 #include "lcd_hw.h"
 #include "lcd_grph.h"
 #include "controller.h"
+#include "event.h"
 #include "mytimer.h"
+#include "log.h"
 
 /*
  * Configure the processor for use with the Keil demo board.  This is very
@@ -23,14 +25,12 @@ extern void vLCD_ISREntry( void );
 
 static void prvSetupHardware( void );
 
-xQueueHandle xGlobalStateQueueQ;
-
 int main (void)
 {
 	/* Setup the hardware for use with the Keil demo board. */
 	prvSetupHardware();
 	
-	xGlobalStateQueueQ = xQueueCreate( 16, sizeof(ulong));
+	vCreateEventQueue();
 		
     /* Start the console task */
 	vStartConsole(2, 19200);
@@ -44,6 +44,9 @@ int main (void)
 	vStartSensors(1);
 
 	vStartLcd(1);
+
+	/* Print the controller's log lines when nothing else needs the CPU */
+	vStartLog(1);
 	
 	/* Start the FreeRTOS Scheduler ... after this we're pre-emptive multitasking ...
 
@@ -68,6 +71,9 @@ static void prvSetupHardware( void )
     PCONP   |= (1 << 3);                 /* Enable UART0 power                */
     PINSEL0 |= 0x00000050;               /* Enable TxD0 and RxD0              */
 
+	/* Free running microsecond clock for tracing */
+	vStartTimestamps();
+
 	/* Initialise LCD hardware */
 	lcd_hw_init();
 
@@ -5,47 +5,114 @@
 #include "queue.h"
 #include "lpc24xx.h"
 #include "controller.h"
+#include "event.h"
 #include "lcd_hw.h"
 #include "timers.h"
+#include "config.h"
+#include "mytimer.h"
+#include "log.h"
 
 #define timerTaskSTACK_SIZE			( ( unsigned portBASE_TYPE ) 256 )
 
+/* Timer1 prescaler for a 1us count */
+#define timerUS_PRESCALE			( ( unsigned long ) ( Fpclk / 1000000 ) - 1 )
+
 static void vTimerCallBack(xTimerHandle xTimer);
 
 extern const portTickType TICKS_TO_WAIT;
-extern const ulong FIVE_SECONDS_PASSED;
-extern xQueueHandle xGlobalStateQueueQ;
 
 int flag;
-xTimerHandle xGlobalTimer;
+
+/* one deadline timer per airlock */
+xTimerHandle xDeadlineTimers[NUMBER_OF_AIRLOCKS];
+
+/* what each airlock's timer sends, NO_EVENT when cancelled, and when and
+ * for how long it was armed.  Only the controller task writes these */
+static volatile ulong deadlineEvent[NUMBER_OF_AIRLOCKS];
+static unsigned long armedAt[NUMBER_OF_AIRLOCKS];
+static unsigned long armedUs[NUMBER_OF_AIRLOCKS];
 
 void vCreateTimer()
 {
-	/* 5 senconds = 5000 miliseconds. so number of ticks for will be 5000/portTICK_RATE_MS */
+	/* the period is set each time a deadline is armed */
 	portTickType period = (portTickType) (5000/portTICK_RATE_MS);
+	ulong airlock;
 
 	/* 
-	 * name is "Timer", with a period of 5 senconds, do not automatically restart, 
-	 * pvTimerID = NULL is because we only use one timer, so we don't have to differentiate it in our callback function
+	 * name is "Timer", do not automatically restart, 
+	 * pvTimerID is the airlock, so the callback knows which one timed out
 	 */
-	xGlobalTimer = xTimerCreate("Timer", period, pdFALSE, NULL, vTimerCallBack);
+	for(airlock=0;airlock<NUMBER_OF_AIRLOCKS;++airlock)
+	{
+		deadlineEvent[airlock] = NO_EVENT;
+		xDeadlineTimers[airlock] = xTimerCreate("Timer", period, pdFALSE, (void *) airlock, vTimerCallBack);
+	}
 }
 
 /* the callback method is called when the timer expired */
 static void vTimerCallBack(xTimerHandle xTimer)
 {
-	/* send timeout message to the global queue */
-	xQueueSend(xGlobalStateQueueQ, &FIVE_SECONDS_PASSED, TICKS_TO_WAIT);	
+	ulong airlock = (ulong) pvTimerGetTimerID(xTimer);
+	ulong event = deadlineEvent[airlock];
+
+	/* send the deadline's event to the controller */
+	if(event != NO_EVENT)
+	{
+		sendEvent((enum EventType) event, SOURCE_TIMER, airlock, ulTimestampUs());
+	}
+}
+
+void armDeadline(ulong airlock, unsigned long ms, ulong event)
+{
+	deadlineEvent[airlock] = event;
+	armedAt[airlock] = ulTimestampUs();
+	armedUs[airlock] = ms * 1000;
+
+	/* changing the period starts a stopped timer and restarts a running one */
+	xTimerChangePeriod(xDeadlineTimers[airlock], (portTickType) (ms / portTICK_RATE_MS), TICKS_TO_WAIT);
+	logWrite("airlock %lu: deadline in %lu ms", airlock, ms);
+}
+
+void cancelDeadline(ulong airlock)
+{
+	if(deadlineEvent[airlock] == NO_EVENT)
+	{
+		return;
+	}
+	deadlineEvent[airlock] = NO_EVENT;
+	xTimerStop(xDeadlineTimers[airlock], TICKS_TO_WAIT);
+	logWrite("airlock %lu: deadline cancelled", airlock, 0);
+}
+
+int deadlineCurrent(ulong airlock, ulong type, unsigned long timestamp)
+{
+	/* the timer can fire up to a tick early */
+	const unsigned long slackUs = portTICK_RATE_MS * 1000;
+
+	if(airlock >= NUMBER_OF_AIRLOCKS || type != deadlineEvent[airlock])
+	{
+		return 0;
+	}
+
+	/* one that fired for an earlier deadline, before the timer task got
+	 * round to re-arming it, fired before or too soon after this one was
+	 * armed.  Signed, so before is negative */
+	return (long) (timestamp - armedAt[airlock]) + (long) slackUs >= (long) armedUs[airlock];
 }
 
-void startTimer()
+/* Timer1 counts microseconds from here on, free running.  The RTOS tick is
+ * on Timer0, so Timer1 is ours */
+void vStartTimestamps()
 {
-	xTimerStart(xGlobalTimer, TICKS_TO_WAIT);
-	printf("timer started\r\n");
+	PCONP |= (1 << 2);				/* Enable Timer1 power */
+	T1TCR = 0x02;					/* Hold in reset */
+	T1CTCR = 0;						/* Count PCLK */
+	T1PR = timerUS_PRESCALE;
+	T1MCR = 0;						/* No match actions, wrap at 2^32 */
+	T1TCR = 0x01;					/* Run */
 }
 
-void stopTimer()
+unsigned long ulTimestampUs()
 {
-	xTimerStop(xGlobalTimer, TICKS_TO_WAIT);
-	printf("timer stopped\r\n");
+	return T1TC;
 }
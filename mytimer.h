@@ -3,6 +3,18 @@
 
 void vCreateTimer(void);
 
-void startTimer(void);
-void stopTimer(void);
+/* arm an airlock's deadline, replacing any armed before: unless it is
+ * cancelled or armed again first, event reaches the controller from
+ * SOURCE_TIMER after ms milliseconds */
+void armDeadline(unsigned long airlock, unsigned long ms, unsigned long event);
+void cancelDeadline(unsigned long airlock);
+
+/* whether a SOURCE_TIMER event is for the deadline armed now, and not one
+ * that fired just before it was cancelled or armed again */
+int deadlineCurrent(unsigned long airlock, unsigned long type, unsigned long timestamp);
+
+/* Microsecond timestamps from a free running hardware timer.  Wraps every
+ * 71 minutes, so only compare them by subtraction */
+void vStartTimestamps(void);
+unsigned long ulTimestampUs(void);
 #endif
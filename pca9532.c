@@ -0,0 +1,437 @@
+/*
+	PCA9532 LED dimmer / GPIO expander.
+
+	Keeps a shadow copy of each expander's registers so that writes which
+	do not change anything never reach the bus, and so that changes to
+	several registers go out together as one auto-increment burst.
+*/
+
+/* Scheduler includes. */
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include "i2c.h"
+#include "pca9532.h"
+
+/*-----------------------------------------------------------*/
+
+/* Control register auto-increment flag */
+#define pcaAUTO_INCREMENT		( ( unsigned char ) 0x10 )
+
+/* First and last writable registers */
+#define pcaFIRST_WRITABLE		pcaPSC0
+#define pcaLAST_WRITABLE		pcaLS3
+
+/* Prescaler input clock: the blink period is (PSCx + 1) / 152 seconds */
+#define pcaPSC_CLOCK_HZ			( ( unsigned long ) 152 )
+
+/* Number of write bursts that can be in flight at once */
+#define pcaWRITES_IN_FLIGHT		4
+
+/* Control byte plus every writable register */
+#define pcaMAX_BURST			( 1 + pcaLAST_WRITABLE - pcaFIRST_WRITABLE + 1 )
+
+/*-----------------------------------------------------------*/
+
+/* Write descriptors that are not queued on the bus, shared by every
+device.  The driver posts each one back here when it has been sent. */
+static xQueueHandle xWritesFreeQ;
+static xI2CTransaction xWrites[ pcaWRITES_IN_FLIGHT ];
+static unsigned char ucWriteData[ pcaWRITES_IN_FLIGHT ][ pcaMAX_BURST ];
+
+/* The device each descriptor last carried a burst for and the registers
+in it, until its completion has been looked at.  NULL once it has. */
+static xPCA9532 *pxWriteDevice[ pcaWRITES_IN_FLIGHT ];
+static unsigned short usWriteSpan[ pcaWRITES_IN_FLIGHT ];
+
+/* Completion queue for register reads. */
+static xQueueHandle xReadDoneQ;
+
+/* Guards the shadow registers of every device and the shared read
+completion queue.  A mutex, so a low priority poller holding it is
+boosted while a higher priority task waits. */
+static xSemaphoreHandle xShadowMutex;
+
+static xPCA9532Stats xStats;
+
+/*-----------------------------------------------------------*/
+
+/*
+ * Create the queues and write descriptors shared by every device.
+ */
+static void prvSetupPool( void );
+
+/*
+ * vPCA9532Write() for callers that already hold xShadowMutex.
+ */
+static void prvWrite( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxRegister, unsigned char ucValue );
+
+/*
+ * Look at every write burst that has finished since the last call.  The
+ * registers of one that failed are marked dirty again, and no longer known,
+ * so the next flush sends them again.  Called with xShadowMutex held.
+ */
+static void prvReclaimWrites( void );
+
+/*-----------------------------------------------------------*/
+
+static void prvSetupPool( void )
+{
+unsigned portBASE_TYPE ux;
+xI2CTransaction *pxWrite;
+
+	xShadowMutex = xSemaphoreCreateMutex();
+	xReadDoneQ = xQueueCreate( 1, ( unsigned portBASE_TYPE ) sizeof( xI2CTransaction * ) );
+	xWritesFreeQ = xQueueCreate( pcaWRITES_IN_FLIGHT, ( unsigned portBASE_TYPE ) sizeof( xI2CTransaction * ) );
+
+	for( ux = 0; ux < pcaWRITES_IN_FLIGHT; ux++ )
+	{
+		pxWrite = &xWrites[ ux ];
+		pxWrite->pucWrite = ucWriteData[ ux ];
+		pxWrite->uxWriteLen = 0;
+		pxWrite->pucRead = NULL;
+		pxWrite->uxReadLen = 0;
+		pxWrite->xRepeatedStart = pdFALSE;
+		pxWrite->ulMaxHz = pcaMAX_HZ;
+		pxWrite->xDoneQ = xWritesFreeQ;
+		pxWrite->xStatus = i2cOK;
+		pxWriteDevice[ ux ] = NULL;
+		xQueueSend( xWritesFreeQ, &pxWrite, 0 );
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvReclaimWrites( void )
+{
+unsigned portBASE_TYPE ux;
+xPCA9532 *pxDevice;
+
+	for( ux = 0; ux < pcaWRITES_IN_FLIGHT; ux++ )
+	{
+		pxDevice = pxWriteDevice[ ux ];
+		if( ( pxDevice == NULL ) || ( xWrites[ ux ].xStatus == i2cPENDING ) )
+		{
+			continue;
+		}
+
+		if( xWrites[ ux ].xStatus != i2cOK )
+		{
+			/* NACKed, or timed out and the bus recovered: the device may
+			hold any of the values, so none of them are skipped as
+			redundant until they have been written again. */
+			pxDevice->usDirty |= usWriteSpan[ ux ];
+			pxDevice->usKnown &= ( unsigned short ) ~usWriteSpan[ ux ];
+			xStats.ulWriteErrors++;
+		}
+		pxWriteDevice[ ux ] = NULL;
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPCA9532Init( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxBus, unsigned char ucAddress, portBASE_TYPE xReadback )
+{
+xI2CTransaction *pxRead = &pxDevice->xInputRead;
+
+	if( xWritesFreeQ == NULL )
+	{
+		prvSetupPool();
+	}
+
+	vI2CInit( uxBus );
+
+	pxDevice->uxBus = uxBus;
+	pxDevice->ucAddress = ucAddress;
+
+	/* The expander may have kept its state across our reset, so nothing
+	is known until it has been written once. */
+	pxDevice->usDirty = 0;
+	pxDevice->usKnown = 0;
+
+	pxDevice->ulFlushes = 0;
+	pxDevice->ulFlushesAtRead = 0;
+	pxDevice->uxInputClient = 0;
+	pxDevice->uxOutputClient = 0;
+
+	/* Both input registers, and optionally everything after them, in one
+	auto-increment read. */
+	pxDevice->ucInputControl = pcaAUTO_INCREMENT | pcaINPUT0;
+	pxRead->uxBus = uxBus;
+	pxRead->ucAddress = ucAddress;
+	pxRead->pucWrite = &pxDevice->ucInputControl;
+	pxRead->uxWriteLen = 1;
+	pxRead->pucRead = pxDevice->ucInput;
+	pxRead->uxReadLen = ( xReadback == pdTRUE ) ? pcaNUM_REGISTERS : 2;
+	pxRead->xRepeatedStart = pdTRUE;
+	pxRead->ulMaxHz = pcaMAX_HZ;
+	pxRead->uxClient = 0;
+	pxRead->xDoneQ = NULL;
+	pxRead->xStatus = i2cOK;
+}
+/*-----------------------------------------------------------*/
+
+void vPCA9532SetClients( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxInputClient, unsigned portBASE_TYPE uxOutputClient )
+{
+	xSemaphoreTake( xShadowMutex, portMAX_DELAY );
+	pxDevice->uxInputClient = uxInputClient;
+	pxDevice->uxOutputClient = uxOutputClient;
+	pxDevice->xInputRead.uxClient = uxInputClient;
+	xSemaphoreGive( xShadowMutex );
+}
+/*-----------------------------------------------------------*/
+
+void vPCA9532Write( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxRegister, unsigned char ucValue )
+{
+	xSemaphoreTake( xShadowMutex, portMAX_DELAY );
+	prvWrite( pxDevice, uxRegister, ucValue );
+	xSemaphoreGive( xShadowMutex );
+}
+/*-----------------------------------------------------------*/
+
+static void prvWrite( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxRegister, unsigned char ucValue )
+{
+unsigned short usBit = ( unsigned short ) ( 1 << uxRegister );
+
+	xStats.ulWrites++;
+
+	prvReclaimWrites();
+	if( ( pxDevice->usKnown & usBit ) && ( pxDevice->ucShadow[ uxRegister ] == ucValue ) )
+	{
+		xStats.ulWritesSkipped++;
+		return;
+	}
+
+	pxDevice->ucShadow[ uxRegister ] = ucValue;
+	pxDevice->usDirty |= usBit;
+	pxDevice->usKnown |= usBit;
+}
+/*-----------------------------------------------------------*/
+
+void vPCA9532SetLed( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxLed, unsigned portBASE_TYPE uxMode )
+{
+unsigned portBASE_TYPE uxRegister = pcaLS0 + ( uxLed >> 2 );
+unsigned portBASE_TYPE uxShift = ( uxLed & 3 ) << 1;
+unsigned char ucValue;
+
+	xSemaphoreTake( xShadowMutex, portMAX_DELAY );
+
+	ucValue = pxDevice->ucShadow[ uxRegister ];
+	ucValue &= ( unsigned char ) ~( 3 << uxShift );
+	ucValue |= ( unsigned char ) ( ( uxMode & 3 ) << uxShift );
+	prvWrite( pxDevice, uxRegister, ucValue );
+
+	xSemaphoreGive( xShadowMutex );
+}
+/*-----------------------------------------------------------*/
+
+void vPCA9532SetBlink( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxChannel, unsigned long ulPeriodMs, unsigned portBASE_TYPE uxDutyPercent )
+{
+unsigned long ulPrescale, ulDuty;
+
+	/* PSCx = period * 152 - 1, rounded to the nearest step. */
+	ulPrescale = ( ulPeriodMs * pcaPSC_CLOCK_HZ + 500 ) / 1000;
+	if( ulPrescale > 0 )
+	{
+		ulPrescale--;
+	}
+	if( ulPrescale > 255 )
+	{
+		ulPrescale = 255;
+	}
+
+	/* The LED is on for PWMx / 256 of the period. */
+	ulDuty = ( ( unsigned long ) uxDutyPercent * 256 + 50 ) / 100;
+	if( ulDuty > 255 )
+	{
+		ulDuty = 255;
+	}
+
+	xSemaphoreTake( xShadowMutex, portMAX_DELAY );
+
+	if( uxChannel == 0 )
+	{
+		prvWrite( pxDevice, pcaPSC0, ( unsigned char ) ulPrescale );
+		prvWrite( pxDevice, pcaPWM0, ( unsigned char ) ulDuty );
+	}
+	else
+	{
+		prvWrite( pxDevice, pcaPSC1, ( unsigned char ) ulPrescale );
+		prvWrite( pxDevice, pcaPWM1, ( unsigned char ) ulDuty );
+	}
+
+	xSemaphoreGive( xShadowMutex );
+}
+/*-----------------------------------------------------------*/
+
+void vPCA9532Flush( xPCA9532 *pxDevice )
+{
+unsigned portBASE_TYPE uxFirst, uxLast, ux;
+xI2CTransaction *pxWrite;
+unsigned char *pucData;
+
+	xSemaphoreTake( xShadowMutex, portMAX_DELAY );
+
+	prvReclaimWrites();
+	if( pxDevice->usDirty == 0 )
+	{
+		xSemaphoreGive( xShadowMutex );
+		return;
+	}
+
+	/* Waiting for a descriptor may have let more bursts finish. */
+	xQueueReceive( xWritesFreeQ, &pxWrite, portMAX_DELAY );
+	prvReclaimWrites();
+
+	/* Find the span covering every dirty register.  Clean registers inside
+	the span are rewritten with their shadow value, which costs one byte
+	each instead of a whole extra transaction. */
+	uxFirst = pcaFIRST_WRITABLE;
+	while( !( pxDevice->usDirty & ( 1 << uxFirst ) ) )
+	{
+		uxFirst++;
+	}
+	uxLast = pcaLAST_WRITABLE;
+	while( !( pxDevice->usDirty & ( 1 << uxLast ) ) )
+	{
+		uxLast--;
+	}
+
+	pxWrite->uxBus = pxDevice->uxBus;
+	pxWrite->ucAddress = pxDevice->ucAddress;
+	pxWrite->uxClient = pxDevice->uxOutputClient;
+	pucData = ( unsigned char * ) pxWrite->pucWrite;
+	pucData[ 0 ] = pcaAUTO_INCREMENT | ( unsigned char ) uxFirst;
+	for( ux = uxFirst; ux <= uxLast; ux++ )
+	{
+		pucData[ 1 + ux - uxFirst ] = pxDevice->ucShadow[ ux ];
+	}
+	pxWrite->uxWriteLen = 2 + uxLast - uxFirst;
+
+	pxWriteDevice[ pxWrite - xWrites ] = pxDevice;
+	usWriteSpan[ pxWrite - xWrites ] = ( unsigned short ) ( ( ( 1 << ( uxLast + 1 ) ) - 1 ) & ~( ( 1 << uxFirst ) - 1 ) );
+
+	pxDevice->usDirty = 0;
+	pxDevice->ulFlushes++;
+	xStats.ulTransactions++;
+
+	/* Submit before releasing the lock so bursts reach the bus in the
+	order their shadow values were taken. */
+	xI2CSubmit( pxWrite, portMAX_DELAY );
+
+	xSemaphoreGive( xShadowMutex );
+}
+/*-----------------------------------------------------------*/
+
+unsigned char ucPCA9532Read( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxRegister )
+{
+unsigned char ucControl = ( unsigned char ) uxRegister;
+unsigned char ucValue = 0;
+xI2CTransaction xRead;
+
+	xRead.uxBus = pxDevice->uxBus;
+	xRead.ucAddress = pxDevice->ucAddress;
+	xRead.pucWrite = &ucControl;
+	xRead.uxWriteLen = 1;
+	xRead.pucRead = &ucValue;
+	xRead.uxReadLen = 1;
+	xRead.xRepeatedStart = pdTRUE;
+	xRead.ulMaxHz = pcaMAX_HZ;
+	xRead.xDoneQ = xReadDoneQ;
+
+	/* Held across the transfer as the completion queue is shared. */
+	xSemaphoreTake( xShadowMutex, portMAX_DELAY );
+
+	xRead.uxClient = pxDevice->uxInputClient;
+	if( xI2CTransfer( &xRead ) != i2cOK )
+	{
+		ucValue = pxDevice->ucShadow[ uxRegister ];
+	}
+	else if( !( pxDevice->usDirty & ( 1 << uxRegister ) ) )
+	{
+		/* Don't let a readback overwrite a change that has not been
+		flushed. */
+		pxDevice->ucShadow[ uxRegister ] = ucValue;
+		pxDevice->usKnown |= ( unsigned short ) ( 1 << uxRegister );
+	}
+
+	xSemaphoreGive( xShadowMutex );
+
+	return ucValue;
+}
+/*-----------------------------------------------------------*/
+
+portBASE_TYPE xPCA9532StartInputRead( xPCA9532 *pxDevice, xQueueHandle xDoneQ )
+{
+portBASE_TYPE xReturn;
+
+	xSemaphoreTake( xShadowMutex, portMAX_DELAY );
+
+	pxDevice->xInputRead.xDoneQ = xDoneQ;
+	pxDevice->ulFlushesAtRead = pxDevice->ulFlushes;
+	xReturn = xI2CSubmit( &pxDevice->xInputRead, portMAX_DELAY );
+
+	xSemaphoreGive( xShadowMutex );
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+portBASE_TYPE xPCA9532Inputs( xPCA9532 *pxDevice, unsigned short *pusInputs )
+{
+unsigned portBASE_TYPE ux;
+unsigned short usBit;
+portBASE_TYPE xReturn = pdFAIL;
+
+	xSemaphoreTake( xShadowMutex, portMAX_DELAY );
+
+	if( pxDevice->xInputRead.xStatus == i2cOK )
+	{
+		pxDevice->ucShadow[ pcaINPUT0 ] = pxDevice->ucInput[ pcaINPUT0 ];
+		pxDevice->ucShadow[ pcaINPUT1 ] = pxDevice->ucInput[ pcaINPUT1 ];
+		pxDevice->usKnown |= ( 1 << pcaINPUT0 ) | ( 1 << pcaINPUT1 );
+
+		/* Check the readback, unless a flush was queued after the read and
+		so may not have reached the device when it was sampled. */
+		if( ( pxDevice->xInputRead.uxReadLen > 2 ) && ( pxDevice->ulFlushesAtRead == pxDevice->ulFlushes ) )
+		{
+			for( ux = pcaFIRST_WRITABLE; ux <= pcaLAST_WRITABLE; ux++ )
+			{
+				usBit = ( unsigned short ) ( 1 << ux );
+				if( ( pxDevice->usKnown & usBit ) && !( pxDevice->usDirty & usBit ) && ( pxDevice->ucInput[ ux ] != pxDevice->ucShadow[ ux ] ) )
+				{
+					pxDevice->usDirty |= usBit;
+					xStats.ulReadbackErrors++;
+				}
+			}
+		}
+	}
+	else
+	{
+		/* The pins may have changed since the last good read. */
+		pxDevice->usKnown &= ~( ( 1 << pcaINPUT0 ) | ( 1 << pcaINPUT1 ) );
+	}
+
+	/* Until a read succeeds the shadow holds zeros, not the pins. */
+	if( ( pxDevice->usKnown & ( 1 << pcaINPUT0 ) ) && ( pxDevice->usKnown & ( 1 << pcaINPUT1 ) ) )
+	{
+		*pusInputs = ( unsigned short ) ( ( pxDevice->ucShadow[ pcaINPUT1 ] << 8 ) | pxDevice->ucShadow[ pcaINPUT0 ] );
+		xReturn = pdPASS;
+	}
+
+	xSemaphoreGive( xShadowMutex );
+
+	return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+unsigned char ucPCA9532Shadow( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxRegister )
+{
+	return pxDevice->ucShadow[ uxRegister ];
+}
+/*-----------------------------------------------------------*/
+
+void vPCA9532GetStats( xPCA9532Stats *pxStats )
+{
+	*pxStats = xStats;
+}
+/*-----------------------------------------------------------*/
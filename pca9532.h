@@ -0,0 +1,135 @@
+#ifndef PCA9532_H
+#define PCA9532_H
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "i2c.h"
+
+/* Base bus address (8-bit form, R/W bit clear).  A0-A2 select one of
+eight devices from 0xC0 to 0xCE. */
+#define pcaADDRESS			( ( unsigned char ) 0xC0 )
+
+/* Fastest SCL rate the PCA9532 supports */
+#define pcaMAX_HZ			i2cFAST_MODE_HZ
+
+/* PCA9532 registers */
+#define pcaINPUT0			0
+#define pcaINPUT1			1
+#define pcaPSC0				2
+#define pcaPWM0				3
+#define pcaPSC1				4
+#define pcaPWM1				5
+#define pcaLS0				6
+#define pcaLS1				7
+#define pcaLS2				8
+#define pcaLS3				9
+#define pcaNUM_REGISTERS	10
+
+/* LED selector values for the LSx registers */
+#define pcaLED_OFF			0
+#define pcaLED_ON			1
+#define pcaLED_PWM0			2		/* blink/dim at PSC0/PWM0 rate */
+#define pcaLED_PWM1			3		/* blink/dim at PSC1/PWM1 rate */
+
+/* Number of LED outputs and blink channels */
+#define pcaNUM_LEDS			16
+#define pcaNUM_BLINKERS		2
+
+/* Longest blink period the prescaler can produce (256/152 s) */
+#define pcaMAX_BLINK_MS		1684
+
+/*
+ * One PCA9532 on a bus: its shadow registers and a descriptor for
+ * polling its inputs.  Treat the members as private to pca9532.c; every
+ * function below takes a priority-inheritance lock around them, so
+ * several tasks may share a device.
+ */
+typedef struct PCA9532
+{
+	unsigned portBASE_TYPE uxBus;
+	unsigned char ucAddress;
+	unsigned char ucShadow[ pcaNUM_REGISTERS ];
+	unsigned short usDirty;			/* shadow newer than the device */
+	unsigned short usKnown;			/* device value known at all */
+	unsigned char ucInputControl;
+	unsigned char ucInput[ pcaNUM_REGISTERS ];	/* INPUT0 first */
+	unsigned long ulFlushes;
+	unsigned long ulFlushesAtRead;
+	unsigned portBASE_TYPE uxInputClient;
+	unsigned portBASE_TYPE uxOutputClient;
+	xI2CTransaction xInputRead;
+} xPCA9532;
+
+/* Bus traffic counters for the shadow register cache, all devices */
+typedef struct PCA9532_STATS
+{
+	unsigned long ulWrites;			/* register writes requested */
+	unsigned long ulWritesSkipped;	/* writes that matched the shadow copy */
+	unsigned long ulTransactions;	/* write bursts actually sent */
+	unsigned long ulReadbackErrors;	/* registers found not to match the shadow */
+	unsigned long ulWriteErrors;	/* write bursts that failed and were sent again */
+} xPCA9532Stats;
+
+/*
+ * Set up a device at ucAddress on bus uxBus (i2cBUS0 to i2cBUS2), starting
+ * the bus if need be.  When xReadback is pdTRUE each input poll reads the whole register file in
+ * the same burst and any register that does not match its shadow copy is
+ * written again on the next flush.
+ */
+void vPCA9532Init( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxBus, unsigned char ucAddress, portBASE_TYPE xReadback );
+
+/*
+ * Bus client IDs (see xI2CTransaction) charged for input reads and for
+ * register writes.  Both default to 0.
+ */
+void vPCA9532SetClients( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxInputClient, unsigned portBASE_TYPE uxOutputClient );
+
+/*
+ * Update the shadow copy of a register.  Nothing goes on the bus until
+ * vPCA9532Flush() is called, and nothing at all if the value is unchanged.
+ */
+void vPCA9532Write( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxRegister, unsigned char ucValue );
+
+/*
+ * Send every dirty register as one auto-increment burst.  Returns without
+ * waiting for the bus.  The registers of an earlier burst that failed are
+ * dirty again, so they go out with this one.
+ */
+void vPCA9532Flush( xPCA9532 *pxDevice );
+
+/*
+ * Select what drives one LED (0-15): one of the pcaLED_ values.  Goes out
+ * on the next flush like any other register write.
+ */
+void vPCA9532SetLed( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxLed, unsigned portBASE_TYPE uxMode );
+
+/*
+ * Program blink channel 0 or 1: the period in milliseconds (up to
+ * pcaMAX_BLINK_MS, or a few ms for dimming) and the percentage of it the
+ * LED is on.  LEDs selected with pcaLED_PWM0/1 then blink or dim without
+ * any further bus traffic.
+ */
+void vPCA9532SetBlink( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxChannel, unsigned long ulPeriodMs, unsigned portBASE_TYPE uxDutyPercent );
+
+/*
+ * Read a register from the device, refreshing its shadow copy.  Blocks
+ * until the transfer completes.
+ */
+unsigned char ucPCA9532Read( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxRegister );
+
+/*
+ * Queue a read of INPUT0 and INPUT1 as one auto-increment burst and
+ * return.  The descriptor is posted to xDoneQ when the read finishes,
+ * after which xPCA9532Inputs() stores all 16 pins in *pusInputs, INPUT1 in
+ * the high byte, and returns pdPASS.  If the read failed it returns pdFAIL
+ * and leaves *pusInputs alone.
+ */
+portBASE_TYPE xPCA9532StartInputRead( xPCA9532 *pxDevice, xQueueHandle xDoneQ );
+portBASE_TYPE xPCA9532Inputs( xPCA9532 *pxDevice, unsigned short *pusInputs );
+
+/* Shadow copy of a register, no bus access */
+unsigned char ucPCA9532Shadow( xPCA9532 *pxDevice, unsigned portBASE_TYPE uxRegister );
+
+void vPCA9532GetStats( xPCA9532Stats *pxStats );
+
+#endif
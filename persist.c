@@ -0,0 +1,75 @@
+/* Controller state kept across a warm reset.  The record is this file's
+ * only zero initialised data, and LCD.sct places it in on-chip RAM marked
+ * UNINIT, so start up leaves it as the last transition wrote it.  A power
+ * on leaves garbage there, which the CRC rejects. */
+#include "FreeRTOS.h"
+#include "lpc24xx.h"
+#include "controller.h"
+#include "persist.h"
+
+#define PERSIST_MAGIC			0x4149524CUL	/* "AIRL" */
+
+/* CRC-16/CCITT */
+#define CRC_POLYNOMIAL			0x1021
+#define CRC_INITIAL				0xFFFF
+
+struct PersistedState
+{
+	unsigned long magic;
+	struct ControllerState controller;
+	unsigned long crc;					/* of everything above */
+};
+
+static struct PersistedState saved;
+
+/* written once, as the controller starts; initialised so it is not
+ * zero initialised data and stays out of the UNINIT region */
+static unsigned long resetCause = ~0UL;
+
+static unsigned long crc16(const unsigned char *data, unsigned int length)
+{
+	unsigned long crc = CRC_INITIAL;
+	int bit;
+
+	while(length--)
+	{
+		crc ^= (unsigned long) *data++ << 8;
+		for(bit=0; bit<8; ++bit)
+		{
+			crc = (crc & 0x8000) ? (crc << 1) ^ CRC_POLYNOMIAL : crc << 1;
+		}
+	}
+	return crc & 0xFFFF;
+}
+
+void savePersistedState(const struct ControllerState *state)
+{
+	saved.magic = PERSIST_MAGIC;
+	saved.controller = *state;
+	saved.crc = crc16((const unsigned char *) &saved, sizeof(saved) - sizeof(saved.crc));
+}
+
+portBASE_TYPE restorePersistedState(struct ControllerState *state)
+{
+	resetCause = RSID & (RESET_POWER_ON | RESET_EXTERNAL | RESET_WATCHDOG | RESET_BROWN_OUT);
+	RSID = RESET_POWER_ON | RESET_EXTERNAL | RESET_WATCHDOG | RESET_BROWN_OUT;
+
+	/* on chip RAM does not survive losing power */
+	if(resetCause & (RESET_POWER_ON | RESET_BROWN_OUT))
+	{
+		return pdFALSE;
+	}
+	if(saved.magic != PERSIST_MAGIC ||
+		saved.crc != crc16((const unsigned char *) &saved, sizeof(saved) - sizeof(saved.crc)))
+	{
+		return pdFALSE;
+	}
+
+	*state = saved.controller;
+	return pdTRUE;
+}
+
+unsigned long lastResetCause(void)
+{
+	return resetCause;
+}
@@ -0,0 +1,25 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include "FreeRTOS.h"
+#include "controller.h"
+
+/* RSID reset causes */
+#define RESET_POWER_ON			0x01
+#define RESET_EXTERNAL			0x02
+#define RESET_WATCHDOG			0x04
+#define RESET_BROWN_OUT			0x08
+
+/* keep the controller's state for the next warm reset, called by the
+ * controller after every change */
+void savePersistedState(const struct ControllerState *state);
+
+/* at boot: pdTRUE, with the state saved before the reset, if this is a
+ * warm reset (watchdog or reset pin) and the record is intact.  Reads and
+ * clears the reset cause, so call it once */
+portBASE_TYPE restorePersistedState(struct ControllerState *state);
+
+/* RESET_ bits of the last reset, from restorePersistedState() */
+unsigned long lastResetCause(void);
+
+#endif
@@ -14,258 +14,377 @@
 #include <string.h>
 #include "sensors.h"
 #include "controller.h"
-
-#define I2C_AA      0x00000004
-#define I2C_SI      0x00000008
-#define I2C_STO     0x00000010
-#define I2C_STA     0x00000020
-#define I2C_I2EN    0x00000040
-
-extern const ulong OUTDOOR_LOCK_INDOOR_LOCK;
-extern const ulong OUTDOOR_UNLOCK_INDOOR_LOCK;
-extern const ulong OUTDOOR_OPEN_INDOOR_LOCK;
-extern const ulong OUTDOOR_LOCK_INDOOR_UNLOCK;
-extern const ulong OUTDOOR_LOCK_INDOOR_OPEN;
-
-extern const ulong PASSWORD_APPROVED;
-extern const ulong OUTDOOR_BTN_PRESSED;
-extern const ulong FIVE_SECONDS_PASSED;
-extern const ulong OUTDOOR_OPEN;
-extern const ulong OUTDOOR_CLOSE;
-extern const ulong INDOOR_BTN_PRESSED ;
-extern const ulong INDOOR_OPEN;
-extern const ulong INDOOR_CLOSE;
+#include "event.h"
+#include "i2c.h"
+#include "pca9532.h"
+#include "debounce.h"
+#include "mytimer.h"
 
 /* Maximum task stack size */
 #define sensorsSTACK_SIZE			( ( unsigned portBASE_TYPE ) 256 )
 
-/* The LCD task. */
-static void vSensorsTask( void *pvParameters );
-
-extern xQueueHandle xGlobalStateQueueQ;
-
-void vStartSensors( unsigned portBASE_TYPE uxPriority )
-{
-	/* Enable and configure I2C0 */
-	PCONP    |=  (1 << 7);                /* Enable power for I2C0              */
-
-	/* Initialize pins for SDA (P0.27) and SCL (P0.28) functions                */
-	/* We can check this though PINSEL1 table */
-	PINSEL1  &= ~0x03C00000;
-	PINSEL1  |=  0x01400000;
-
-	/* Clear I2C state machine                                                  */
-	I20CONCLR =  I2C_AA | I2C_SI | I2C_STA | I2C_I2EN;
-	
-	/* Setup I2C clock speed                                                    */
-	I20SCLL   =  0x80;
-	I20SCLH   =  0x80;
-	
-	I20CONSET =  I2C_I2EN;
+/* Consecutive polls an input must hold a new level before it counts.  Any
+ * input part way through a change keeps the poll at sensorsMIN_POLL_PERIOD,
+ * so the new level must hold for (7 - 1) * 5 ms = 30 ms: longer than contact
+ * bounce, and bench_debounce sees no false edges from 4 samples up */
+#define sensorsDEBOUNCE_SAMPLES		debounceMAX_SAMPLES
 
-	/* Spawn the console task . */
-	xTaskCreate( vSensorsTask, ( signed char * ) "Sensors", sensorsSTACK_SIZE, NULL, uxPriority, ( xTaskHandle * ) NULL );
+/* Poll period limits in ticks.  The sensors poll at the minimum period
+ * while an input is changing or a door is unlocked, and back off towards
+ * the maximum while everything is idle */
+#define sensorsMIN_POLL_PERIOD		( ( portTickType ) 5 )
+#define sensorsMAX_POLL_PERIOD		( ( portTickType ) 80 )
 
-	printf("Sensor task started ...\r\n");
-}
+/* I2C client IDs, so bus contention is reported separately for input
+ * polling and light updates */
+#define sensorsI2C_CLIENT_POLL		0
+#define sensorsI2C_CLIENT_LIGHTS	1
 
+/* The LCD task. */
+static void vSensorsTask( void *pvParameters );
 
-/* Get I2C button status */
-unsigned char getButtons()
+/* one expander input and the events raised by its edges (NO_EVENT = none) */
+struct SensorInput
 {
-	unsigned char ledData;
-
-	/* Initialise */
-	I20CONCLR =  I2C_AA | I2C_SI | I2C_STA | I2C_STO;
-	
-	/* Request send START */
-	I20CONSET =  I2C_STA;
-
-	/* Wait for START to be sent */
-	while (!(I20CONSET & I2C_SI));
-
-	/* Request send PCA9532 ADDRESS and R/W bit and clear SI */		
-	I20DAT    =  0xC0;
-	I20CONCLR =  I2C_SI | I2C_STA;
-
-	/* Wait for ADDRESS and R/W to be sent */
-	while (!(I20CONSET & I2C_SI));
-
-	/* Send control word to read PCA9532 INPUT0 register */
-	I20DAT = 0x00;
-	I20CONCLR =  I2C_SI;
-
-	/* Wait for DATA with control word to be sent */
-	while (!(I20CONSET & I2C_SI));
-
-	/* Request send repeated START */
-	I20CONSET =  I2C_STA;
-	I20CONCLR =  I2C_SI;
+	unsigned short mask;
+	ulong airlock;
+	ulong pressEvent;
+	const char *pressMessage;
+	ulong releaseEvent;
+	const char *releaseMessage;
+};
+
+/* one PCA9532 and the doors wired to it */
+struct Expander
+{
+	unsigned portBASE_TYPE bus;	/* i2cBUS0 to i2cBUS2 */
+	unsigned char address;
+	unsigned short activeLow;	/* inputs that read 0 when pressed/closed */
+	portBASE_TYPE readback;		/* check LED registers on every poll */
+	const struct SensorInput *inputs;
+	int inputCount;
+};
+
+/* door contacts and buttons of airlock 0, on the first expander */
+static const struct SensorInput doorInputs[] =
+{
+	{ 1 << 0, 0, OUTDOOR_BTN_PRESSED, "button A press", NO_EVENT, NULL },
+	/* outer door pressed means open, release means close */
+	{ 1 << 1, 0, OUTDOOR_OPEN, "button B hold", OUTDOOR_CLOSE, "button B release" },
+	{ 1 << 2, 0, INDOOR_BTN_PRESSED, "button C press", NO_EVENT, NULL },
+	{ 1 << 3, 0, INDOOR_OPEN, "button D hold", INDOOR_CLOSE, "button D realse" }
+};
+
+/* every expander on the board; add a row per extra PCA9532.  Expanders on
+ * different buses are polled and written in parallel */
+static const struct Expander expanderConfig[] =
+{
+	{ i2cBUS0, pcaADDRESS, 0x000f, pdFALSE, doorInputs, sizeof(doorInputs) / sizeof(doorInputs[0]) }
+};
 
-	/* Wait for START to be sent */
-	while (!(I20CONSET & I2C_SI));
+#define sensorsNUM_EXPANDERS		( sizeof(expanderConfig) / sizeof(expanderConfig[0]) )
 
-	/* Request send PCA9532 ADDRESS and R/W bit and clear SI */		
-	I20DAT    =  0xC1;
-	I20CONCLR =  I2C_SI | I2C_STA;
+static xPCA9532 expanders[sensorsNUM_EXPANDERS];
+static xDebouncer debouncers[sensorsNUM_EXPANDERS];
 
-	/* Wait for ADDRESS and R/W to be sent */
-	while (!(I20CONSET & I2C_SI));
+/* the input bits of each expander that are wired to a SensorInput.  The
+ * others are LED pins reading back what the lights show, and must not
+ * count as edges */
+static unsigned short inputMask[sensorsNUM_EXPANDERS];
 
-	I20CONCLR = I2C_SI;
+/* completion queue for the poll reads, one slot per expander */
+static xQueueHandle xPollDoneQ;
 
-	/* Wait for DATA to be received */
-	while (!(I20CONSET & I2C_SI));
+/* set by the controller while a door is unlocked */
+static volatile portBASE_TYPE xDoorsActive = pdFALSE;
 
-	ledData = I20DAT;
+/* poll statistics, index sensorsFAST_POLL or sensorsSLOW_POLL */
+#define sensorsFAST_POLL			0
+#define sensorsSLOW_POLL			1
+static struct PollStats pollStats[2];
 
-	/* Request send NAQ and STOP */
-	I20CONSET =  I2C_STO;
-	I20CONCLR =  I2C_SI | I2C_AA;
+void vStartSensors( unsigned portBASE_TYPE uxPriority )
+{
+	unsigned int i;
+	int j;
+
+	/* each expander starts the bus it is on */
+	for(i=0;i<sensorsNUM_EXPANDERS;++i)
+	{
+		for(j=0;j<expanderConfig[i].inputCount;++j)
+		{
+			inputMask[i] |= expanderConfig[i].inputs[j].mask;
+		}
+		vPCA9532Init(&expanders[i], expanderConfig[i].bus, expanderConfig[i].address, expanderConfig[i].readback);
+		vPCA9532SetClients(&expanders[i], sensorsI2C_CLIENT_POLL, sensorsI2C_CLIENT_LIGHTS);
+		vDebounceInit(&debouncers[i], sensorsDEBOUNCE_SAMPLES, 0);
+	}
+	xPollDoneQ = xQueueCreate(sensorsNUM_EXPANDERS, sizeof(xI2CTransaction *));
 
-	/* Wait for STOP to be sent */
-	while (I20CONSET & I2C_STO);
+	/* Spawn the console task . */
+	xTaskCreate( vSensorsTask, ( signed char * ) "Sensors", sensorsSTACK_SIZE, NULL, uxPriority, ( xTaskHandle * ) NULL );
 
-	return ledData ^ 0xf;
+	printf("Sensor task started ...\r\n");
 }
 
-unsigned char setLightOff(int index)
+/* Read and debounce the inputs of every expander.  All reads are queued at
+ * once so the driver runs them back to back, and the task only wakes when
+ * the last one is done.  An expander that could not be read keeps its
+ * last debounced state.  Returns when the inputs were sampled, from
+ * ulTimestampUs() */
+static unsigned long pollExpanders(unsigned short inputState[])
 {
-	unsigned char light = (0x3 << (index *2));
-	return ~light;
+	unsigned int i;
+	xI2CTransaction *done;
+	unsigned long sampled;
+	unsigned short inputs;
+
+	for(i=0;i<sensorsNUM_EXPANDERS;++i)
+	{
+		xPCA9532StartInputRead(&expanders[i], xPollDoneQ);
+	}
+	for(i=0;i<sensorsNUM_EXPANDERS;++i)
+	{
+		xQueueReceive(xPollDoneQ, &done, portMAX_DELAY);
+	}
+	sampled = ulTimestampUs();
+
+	for(i=0;i<sensorsNUM_EXPANDERS;++i)
+	{
+		if(xPCA9532Inputs(&expanders[i], &inputs) == pdPASS)
+		{
+			inputState[i] = (unsigned short) ulDebounce(&debouncers[i],
+				(inputs ^ expanderConfig[i].activeLow) & inputMask[i]);
+		}
+	}
+
+	return sampled;
 }
 
-unsigned char setLightOn(int index)
+/* poll fast while doors are unlocked */
+void vSensorsSetActive(portBASE_TYPE active)
 {
-	unsigned char light = 0;
-	light |= (1 << (index*2));
-	return light;
+	xDoorsActive = active;
 }
 
-/* Set I2C LEDs */
-void putLights(unsigned char lights)
+void vSensorsGetPollStats(struct PollStats *fast, struct PollStats *slow)
 {
-	//printf("in put lights: %d\r\n", lights);
-    /* Initialise */
-	I20CONCLR =  I2C_AA | I2C_SI | I2C_STA | I2C_STO;
-
-	/* Request send START */
-	I20CONSET =  I2C_STA;
-
-	/* Wait for START to be sent */
-	while (!(I20CONSET & I2C_SI));
+	vTaskSuspendAll();
+	*fast = pollStats[sensorsFAST_POLL];
+	*slow = pollStats[sensorsSLOW_POLL];
+	xTaskResumeAll();
+}
 
-	/* Request send PCA9532 ADDRESS and R/W bit and clear SI */		
-	I20DAT    =  0xC0;
-	I20CONCLR =  I2C_SI | I2C_STA;
+/* print the poll statistics of each mode.  Bus use is the share of the
+ * time in that mode the expanders' buses spent running transactions,
+ * polls and light writes alike, summed over the buses */
+void vSensorsPrintPollStats(void)
+{
+	static const char *names[] = { "fast", "slow" };
+	struct PollStats stats[2];
+	unsigned long ms, permille;
+	int mode;
+
+	vSensorsGetPollStats(&stats[sensorsFAST_POLL], &stats[sensorsSLOW_POLL]);
+	printf("mode      polls    ticks    edges  max edge latency  bus use\r\n");
+	for(mode=0;mode<2;++mode)
+	{
+		ms = stats[mode].ticks * portTICK_RATE_MS;
+		/* scaled so busyMs * 1000 cannot overflow */
+		if(ms >= 1000000UL)
+		{
+			permille = stats[mode].busyMs / (ms / 1000);
+		}
+		else
+		{
+			permille = ms ? stats[mode].busyMs * 1000 / ms : 0;
+		}
+		printf("%-6s %8lu %8lu %8lu %14lu ms   %3lu.%lu%%\r\n", names[mode],
+			stats[mode].polls, stats[mode].ticks, stats[mode].edges,
+			(unsigned long) (stats[mode].maxEdgeLatency * portTICK_RATE_MS),
+			permille / 10, permille % 10);
+	}
+}
 
-	/* Wait for ADDRESS and R/W to be sent */
-	while (!(I20CONSET & I2C_SI));
+/* bus time so far on every bus with an expander, from the driver */
+static unsigned long busTimeUs(void)
+{
+	xI2CStats stats;
+	unsigned portBASE_TYPE bus;
+	unsigned int i;
+	unsigned long total = 0;
+
+	for(bus=0;bus<i2cNUM_BUSES;++bus)
+	{
+		for(i=0;i<sensorsNUM_EXPANDERS;++i)
+		{
+			if(expanderConfig[i].bus == bus)
+			{
+				vI2CGetStats(bus, &stats);
+				total += stats.ulBusyUs;
+				break;
+			}
+		}
+	}
+	return total;
+}
 
-	/* Send control word to write PCA9532 LS2(LED8-LED11) register */
-	I20DAT = 0x08;
-	I20CONCLR =  I2C_SI;
+/* Set how LIGHT_BLINK lights on an expander blink: the period, and the
+ * percentage of it they are lit.  Goes out on the next flushLights() */
+void setBlinkRate(int expander, unsigned long periodMs, unsigned int dutyPercent)
+{
+	vPCA9532SetBlink(&expanders[expander], 0, periodMs, dutyPercent);
+}
 
-	/* Wait for DATA with control word to be sent */
-	while (!(I20CONSET & I2C_SI));
+/* Set one LED (0-15) of an expander in the shadow registers only; it
+ * goes out on the next flushLights().  A blinking LED needs no further bus
+ * traffic to keep blinking */
+void setLight(int expander, int led, enum LightMode mode)
+{
+	static const unsigned char selectors[] = { pcaLED_OFF, pcaLED_ON, pcaLED_PWM0 };
 
-	I20DAT = lights;
-	I20CONCLR =  I2C_SI;
-	/* Wait for DATA to be sent */
-	while (!(I20CONSET & I2C_SI));
+	vPCA9532SetLed(&expanders[expander], led, selectors[mode]);
+}
 
-	/* Request send NAQ and STOP */
-	I20CONSET =  I2C_STO;
-	I20CONCLR =  I2C_SI | I2C_AA;
+/* Send every expander's changed LED registers, one burst each, without
+ * waiting for the bus.  A light switched and switched back since the last
+ * flush sends nothing */
+void flushLights(void)
+{
+	unsigned int i;
 
-	/* Wait for STOP to be sent */
-	while (I20CONSET & I2C_STO);	
+	for(i=0; i<sensorsNUM_EXPANDERS; ++i)
+	{
+		vPCA9532Flush(&expanders[i]);
+	}
 }
 
 
 static portTASK_FUNCTION( vSensorsTask, pvParameters )
 {
 	portTickType xLastWakeTime;
-	unsigned char buttonState;
-	unsigned char lastButtonState;
-	unsigned char changeState;
-	unsigned char mask[4] = {1 << 0, 1 << 1, 1 << 2, 1<< 3};
+	unsigned short buttonState[sensorsNUM_EXPANDERS];
+	unsigned short lastButtonState[sensorsNUM_EXPANDERS];
+	unsigned short changeState;
+	const struct SensorInput *input;
+	unsigned int i;
+	int j;
+	portTickType period;
+	portTickType now;
+	portBASE_TYPE changing;
+	unsigned long sampled;
+	struct PollStats *stats;
+	/* bus time at the last poll, and what is not yet charged to busyMs */
+	unsigned long busUs, lastBusUs, busyUs = 0;
+	/* last poll at which each expander was stable, bounding when an edge
+	 * first appeared, and the poll mode at that time */
+	portTickType lastStable[sensorsNUM_EXPANDERS];
+	struct PollStats *stableStats[sensorsNUM_EXPANDERS];
 
 	(void) pvParameters;
 	printf("Starting sensor poll ...\r\n");
 
     /* initialise lastState with all buttons off */
-	lastButtonState = 0;
+	memset(lastButtonState, 0, sizeof(lastButtonState));
+	memset(buttonState, 0, sizeof(buttonState));
 
 	/* initial xLastWakeTime for accurate polling interval */
     xLastWakeTime = xTaskGetTickCount();
+	period = sensorsMIN_POLL_PERIOD;
+	lastBusUs = busTimeUs();
+	for(i=0;i<sensorsNUM_EXPANDERS;++i)
+	{
+		lastStable[i] = xLastWakeTime;
+		stableStats[i] = &pollStats[sensorsFAST_POLL];
+	}
 
     while(1)
     {
-    	buttonState = getButtons();
-    	changeState = buttonState ^ lastButtonState;
-
-    	if(buttonState != lastButtonState)
-    	{
-    		if( changeState & mask[0] )
-    		{				
-	    		if( buttonState & mask[0] )
-	    		{
-	    			printf("button A press\r\n");
-	    			xQueueSend(xGlobalStateQueueQ, &OUTDOOR_BTN_PRESSED, 10);
-	    			// sendToGlobalQueue(OUTDOOR_BTN_PRESSED);
-	    		}
-	    	}
-
-    		// outer door pressed means open
-    		if( changeState & mask[1])
-    		{
-				// printf("button 1 changed\r\n");
-				if( buttonState & mask[1] )
+    	sampled = pollExpanders(buttonState);
+		now = xTaskGetTickCount();
+
+		stats = &pollStats[(period == sensorsMIN_POLL_PERIOD) ? sensorsFAST_POLL : sensorsSLOW_POLL];
+		stats->polls++;
+		stats->ticks += period;
+
+		/* the bus time since the last poll goes with the period before
+		 * this one */
+		busUs = busTimeUs();
+		busyUs += busUs - lastBusUs;
+		lastBusUs = busUs;
+		stats->busyMs += busyUs / 1000;
+		busyUs %= 1000;
+
+		changing = pdFALSE;
+		for(i=0;i<sensorsNUM_EXPANDERS;++i)
+		{
+			if(xDebounceBusy(&debouncers[i]))
+			{
+				changing = pdTRUE;
+			}
+
+			changeState = buttonState[i] ^ lastButtonState[i];
+			if(!changeState)
+			{
+				if(!xDebounceBusy(&debouncers[i]))
 				{
-					printf("button B hold\r\n");
-					xQueueSend(xGlobalStateQueueQ, &OUTDOOR_OPEN, 10);
-					// sendToGlobalQueue(OUTDOOR_OPEN);
+					lastStable[i] = now;
+					stableStats[i] = stats;
 				}
-				else // outer door release means close
+				continue;
+			}
+
+			/* the edge happened some time after the last stable poll */
+			stableStats[i]->edges++;
+			if(now - lastStable[i] > stableStats[i]->maxEdgeLatency)
+			{
+				stableStats[i]->maxEdgeLatency = now - lastStable[i];
+			}
+			lastStable[i] = now;
+			stableStats[i] = stats;
+
+			for(j=0;j<expanderConfig[i].inputCount;++j)
+			{
+				input = &expanderConfig[i].inputs[j];
+				if(!(changeState & input->mask))
 				{
-					printf("button B release\r\n");
-					xQueueSend(xGlobalStateQueueQ, &OUTDOOR_CLOSE, 10);
-					// sendToGlobalQueue(OUTDOOR_CLOSE);
+					continue;
 				}
-    		}
-
-    		if( changeState & mask[2] )
-    		{				    			
-				if( buttonState & mask[2] ) 
-    			{
-    				printf("button C press\r\n");
-    				xQueueSend(xGlobalStateQueueQ, &INDOOR_BTN_PRESSED, 10);
-    				// sendToGlobalQueue(INDOOR_BTN_PRESSED);
-    			}
-    		}
-
-    		if( changeState & mask[3] )
-    		{
-				// printf("button 3 changed\r\n");
-	    		if( buttonState & mask[3] )
-	    		{
-	    			printf("button D hold\r\n");
-	    			xQueueSend(xGlobalStateQueueQ, &INDOOR_OPEN, 10);
-	    			// sendToGlobalQueue(INDOOR_OPEN);
-	    		}
-	    		else
-	    		{
-	    			printf("button D realse\r\n");
-	    			xQueueSend(xGlobalStateQueueQ, &INDOOR_CLOSE, 10);
-	    			// sendToGlobalQueue(INDOOR_CLOSE);
-	    		}
-	    	}
+
+				if(buttonState[i] & input->mask)
+				{
+					if(input->pressEvent != NO_EVENT)
+					{
+						printf("%s\r\n", input->pressMessage);
+						sendEvent((enum EventType) input->pressEvent, SOURCE_SENSORS, input->airlock, sampled);
+					}
+				}
+				else if(input->releaseEvent != NO_EVENT)
+				{
+					printf("%s\r\n", input->releaseMessage);
+					sendEvent((enum EventType) input->releaseEvent, SOURCE_SENSORS, input->airlock, sampled);
+				}
+			}
+
 			/* remember new state */
-			lastButtonState = buttonState;    		
-    	}
+			lastButtonState[i] = buttonState[i];
+		}
+
+		/* poll fast while anything is moving, otherwise back off */
+		if(changing || xDoorsActive)
+		{
+			period = sensorsMIN_POLL_PERIOD;
+		}
+		else if(period < sensorsMAX_POLL_PERIOD)
+		{
+			period *= 2;
+			if(period > sensorsMAX_POLL_PERIOD)
+			{
+				period = sensorsMAX_POLL_PERIOD;
+			}
+		}
 
 		/* delay before next poll */
-    	vTaskDelayUntil( &xLastWakeTime, 20);
+    	vTaskDelayUntil( &xLastWakeTime, period);
     }
 }
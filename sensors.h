@@ -2,8 +2,32 @@
 #define SENSORS_H
 
 void vStartSensors( unsigned portBASE_TYPE uxPriority );
-unsigned char setLightOn(int index);
-unsigned char setLightOff(int index);
-void putLights(unsigned char lights);
+
+/* what a light shows.  LIGHT_BLINK lights blink at the rate set with
+ * setBlinkRate() */
+enum LightMode
+{
+	LIGHT_OFF,
+	LIGHT_ON,
+	LIGHT_BLINK
+};
+
+void setLight(int expander, int led, enum LightMode mode);
+void flushLights(void);
+void setBlinkRate(int expander, unsigned long periodMs, unsigned int dutyPercent);
+
+/* sensor poll statistics for one polling mode */
+struct PollStats
+{
+	unsigned long polls;
+	unsigned long ticks;				/* time spent in this mode */
+	unsigned long edges;				/* debounced edges detected */
+	portTickType maxEdgeLatency;		/* worst last-stable-poll to edge time */
+	unsigned long busyMs;				/* expander bus time in this mode */
+};
+
+void vSensorsSetActive(portBASE_TYPE active);
+void vSensorsGetPollStats(struct PollStats *fast, struct PollStats *slow);
+void vSensorsPrintPollStats(void);
 
 #endif
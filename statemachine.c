@@ -0,0 +1,413 @@
+/* The airlock state machine: the transition table, its actions and the
+ * events they defer.  It calls nothing from the RTOS or the hardware, only
+ * setDoorLight() (controller.c), armDeadline() and cancelDeadline() (mytimer.c)
+ * and logWrite() (log.c), so it also builds on a host against stand-ins
+ * for those and the FreeRTOS.h port types.  Only the controller task may
+ * call it. */
+#include "FreeRTOS.h"
+#include "controller.h"
+#include "event.h"
+#include "log.h"
+#include "mytimer.h"
+#include "statemachine.h"
+#include "staticassert.h"
+
+/* run time state of one airlock */
+struct Airlock
+{
+	ulong state;
+
+	/* events parked by waitingState(), in arrival order, at most one of
+	 * each type so it can never overflow */
+	struct Event deferred[NUMBER_OF_TRANSITIONS];
+	int deferredCount;
+
+	/* DOOR_BIT()s of the door lights switched off */
+	unsigned int unlocked;
+};
+
+static struct Airlock airlocks[NUMBER_OF_AIRLOCKS];
+
+/* airlocks with a door unlocked, so the sensors know to poll fast */
+static int unlockedCount;
+
+static unsigned long violations;
+
+static unsigned long alarms;
+
+/* how long a door may stay unlocked without being opened before it
+ * relocks, and open before it raises an alarm */
+#define RELOCK_MS				5000UL
+#define HELD_OPEN_MS			30000UL
+
+/* how long an airlock may stay in a state, and the event it gets when it
+ * has; armed on entering the state and cancelled on leaving it */
+struct Deadline
+{
+	unsigned long ms;			/* 0 for none */
+	ulong event;
+};
+
+static const struct Deadline deadlines[NUMBER_OF_STATES] =
+{
+	{ 0, NO_EVENT },							/* OUTDOOR_LOCK_INDOOR_LOCK */
+	{ RELOCK_MS, FIVE_SECONDS_PASSED },			/* OUTDOOR_UNLOCK_INDOOR_LOCK */
+	{ HELD_OPEN_MS, DOOR_HELD_OPEN },			/* OUTDOOR_OPEN_INDOOR_LOCK */
+	{ RELOCK_MS, FIVE_SECONDS_PASSED },			/* OUTDOOR_LOCK_INDOOR_UNLOCK */
+	{ HELD_OPEN_MS, DOOR_HELD_OPEN }			/* OUTDOOR_LOCK_INDOOR_OPEN */
+};
+
+/* the doors each state has unlocked */
+static const unsigned int doorsUnlockedIn[NUMBER_OF_STATES] =
+{
+	0,						/* OUTDOOR_LOCK_INDOOR_LOCK */
+	DOOR_BIT(OUTER_DOOR),	/* OUTDOOR_UNLOCK_INDOOR_LOCK */
+	DOOR_BIT(OUTER_DOOR),	/* OUTDOOR_OPEN_INDOOR_LOCK */
+	DOOR_BIT(INNER_DOOR),	/* OUTDOOR_LOCK_INDOOR_UNLOCK */
+	DOOR_BIT(INNER_DOOR)	/* OUTDOOR_LOCK_INDOOR_OPEN */
+};
+
+/* the state a saved state comes back as after a warm reset.  The sensors
+ * start out seeing every door closed, so an open door is restored as
+ * unlocked: if it is still open the first polls report it open, and if it
+ * closed during the reset the relock deadline locks it again */
+static const ulong restoredAs[NUMBER_OF_STATES] =
+{
+	OUTDOOR_LOCK_INDOOR_LOCK,		/* OUTDOOR_LOCK_INDOOR_LOCK */
+	OUTDOOR_UNLOCK_INDOOR_LOCK,		/* OUTDOOR_UNLOCK_INDOOR_LOCK */
+	OUTDOOR_UNLOCK_INDOOR_LOCK,		/* OUTDOOR_OPEN_INDOOR_LOCK */
+	OUTDOOR_LOCK_INDOOR_UNLOCK,		/* OUTDOOR_LOCK_INDOOR_UNLOCK */
+	OUTDOOR_LOCK_INDOOR_UNLOCK		/* OUTDOOR_LOCK_INDOOR_OPEN */
+};
+
+/* the event being handled, so a waiting transition can park it whole and
+ * the lights update can be timed against its sample time */
+static struct Event currentEvent;
+
+/* switch a door light and keep track of which doors are unlocked */
+static void switchDoor(ulong airlock, enum Door door, int on)
+{
+	if(on)
+	{
+		airlocks[airlock].unlocked &= ~DOOR_BIT(door);
+	}
+	else
+	{
+		airlocks[airlock].unlocked |= DOOR_BIT(door);
+	}
+	setDoorLight(&currentEvent, airlock, door, on);
+}
+
+static void outdoorBtnPressed(ulong airlock, ulong state_transition)
+{
+	logWrite("airlock %lu: outer door unlock, inner door lock", airlock, 0);
+	switchDoor(airlock, OUTER_DOOR, 0);
+}
+
+static void outdoorFiveSecondsPassed(ulong airlock, ulong state_transition)
+{
+	logWrite("airlock %lu: outer door not opened, outer door lock, inner door lock", airlock, 0);
+	switchDoor(airlock, OUTER_DOOR, 1);
+}
+
+static void outdoorPasswordApproved(ulong airlock, ulong state_transition)
+{
+	logWrite("airlock %lu: outer door unlock, inner door lock", airlock, 0);
+	switchDoor(airlock, OUTER_DOOR, 0);
+}
+
+static void outdoorOpen(ulong airlock, ulong state_transition)
+{
+	logWrite("airlock %lu: outer door open, inner door lock", airlock, 0);
+}
+
+static void outdoorClose(ulong airlock, ulong state_transition)
+{
+	logWrite("airlock %lu: outer door close(lock), inner door lock", airlock, 0);
+	switchDoor(airlock, OUTER_DOOR, 1);
+}
+
+static void indoorBtnPressed(ulong airlock, ulong state_transition)
+{
+	logWrite("airlock %lu: outer door lock, inner door unlock", airlock, 0);
+	switchDoor(airlock, INNER_DOOR, 0);
+}
+
+static void indoorFiveSecondsPassed(ulong airlock, ulong state_transition)
+{
+	logWrite("airlock %lu: inner door not opened, outer door lock, inner door lock", airlock, 0);
+	switchDoor(airlock, INNER_DOOR, 1);
+}
+
+static void indoorOpen(ulong airlock, ulong state_transition)
+{
+	logWrite("airlock %lu: outer door lock, inner door open", airlock, 0);
+}
+
+static void indoorClose(ulong airlock, ulong state_transition)
+{
+	logWrite("airlock %lu: outer door lock, inner door close(lock)", airlock, 0);
+	switchDoor(airlock, INNER_DOOR, 1);
+}
+
+/* the door stays open and the state with it, so the alarm goes off once
+ * per opening */
+static void doorHeldOpen(ulong airlock, ulong state_transition)
+{
+	++alarms;
+	logWrite(airlocks[airlock].state == OUTDOOR_OPEN_INDOOR_LOCK ?
+		"airlock %lu: ALARM outer door held open over %lu ms" :
+		"airlock %lu: ALARM inner door held open over %lu ms", airlock, HELD_OPEN_MS);
+}
+
+static void waitingState(ulong airlock, ulong state_transition)
+{
+	struct Airlock *parked = &airlocks[airlock];
+	int i;
+
+	// park the event until a state that can handle it, once per event type
+	for(i=0;i<parked->deferredCount;++i)
+	{
+		if(parked->deferred[i].type == state_transition)
+		{
+			return;
+		}
+	}
+	parked->deferred[parked->deferredCount++] = currentEvent;
+}
+
+static void emptyState(ulong airlock, ulong state_transition)
+{
+	// do nothing
+	logWrite("airlock %lu: event %lu was rejected by the state machine", airlock, state_transition);
+}
+
+/* what an event does in a state: run the action, then move to the next
+ * state unless that is STAY */
+struct Transition
+{
+	void (*action)(ulong airlock, ulong state_transition);
+	ulong next;
+};
+
+#define STAY					NUMBER_OF_STATES
+
+/* a next state that is out of range does not compile */
+#define CHECKED_STATE(s)		((s) + 0 * sizeof(char[((unsigned) (s) < NUMBER_OF_STATES) ? 1 : -1]))
+
+#define GO(action, next)		{ action, CHECKED_STATE(next) }
+#define REJECT					{ emptyState, STAY }
+/* wait until a state that can handle the event, see waitingState() */
+#define DEFER					{ waitingState, STAY }
+/* raise the held open alarm, see doorHeldOpen() */
+#define ALARM					{ doorHeldOpen, STAY }
+
+/* one cell per event: a short row does not compile, and neither does ROW
+ * itself once its cell count differs from the number of events */
+#define ROW_CELLS						9
+#define ROW(a, b, c, d, e, f, g, h, i)	{ a, b, c, d, e, f, g, h, i }
+
+STATIC_ASSERT(ROW_CELLS == NUMBER_OF_TRANSITIONS, rowHasEveryEvent);
+
+/* transition table, fixed at build time and kept in flash.  Columns:
+ * PASSWORD_APPROVED, OUTDOOR_BTN_PRESSED, FIVE_SECONDS_PASSED, OUTDOOR_OPEN,
+ * OUTDOOR_CLOSE, INDOOR_BTN_PRESSED, INDOOR_OPEN, INDOOR_CLOSE, DOOR_HELD_OPEN
+ *
+ * For example: if the inner door unclock and outer door button press,
+ * My implementation will wait until the inner door lock and then unlock the outer door
+ */
+static const struct Transition stateMachine[][NUMBER_OF_TRANSITIONS] =
+{
+	/* OUTDOOR_LOCK_INDOOR_LOCK */
+	ROW(GO(outdoorPasswordApproved, OUTDOOR_UNLOCK_INDOOR_LOCK), GO(outdoorBtnPressed, OUTDOOR_UNLOCK_INDOOR_LOCK),
+		REJECT, REJECT, REJECT,
+		GO(indoorBtnPressed, OUTDOOR_LOCK_INDOOR_UNLOCK), REJECT, REJECT,
+		REJECT),
+
+	/* OUTDOOR_UNLOCK_INDOOR_LOCK */
+	ROW(REJECT, REJECT, GO(outdoorFiveSecondsPassed, OUTDOOR_LOCK_INDOOR_LOCK),
+		GO(outdoorOpen, OUTDOOR_OPEN_INDOOR_LOCK), REJECT,
+		DEFER, REJECT, REJECT,
+		REJECT),
+
+	/* OUTDOOR_OPEN_INDOOR_LOCK */
+	ROW(REJECT, REJECT, REJECT,
+		REJECT, GO(outdoorClose, OUTDOOR_LOCK_INDOOR_LOCK),
+		DEFER, REJECT, REJECT,
+		ALARM),
+
+	/* OUTDOOR_LOCK_INDOOR_UNLOCK */
+	ROW(DEFER, DEFER, GO(indoorFiveSecondsPassed, OUTDOOR_LOCK_INDOOR_LOCK),
+		REJECT, REJECT,
+		REJECT, GO(indoorOpen, OUTDOOR_LOCK_INDOOR_OPEN), REJECT,
+		REJECT),
+
+	/* OUTDOOR_LOCK_INDOOR_OPEN */
+	ROW(DEFER, DEFER, REJECT,
+		REJECT, REJECT,
+		REJECT, REJECT, GO(indoorClose, OUTDOOR_LOCK_INDOOR_LOCK),
+		ALARM)
+};
+
+/* one row per state, or this does not compile */
+STATIC_ASSERT(sizeof(stateMachine) / sizeof(stateMachine[0]) == NUMBER_OF_STATES, stateMachineHasEveryState);
+
+void initStateMachine(void)
+{
+	ulong airlock;
+
+	for(airlock=0;airlock<NUMBER_OF_AIRLOCKS;++airlock)
+	{
+		airlocks[airlock].state = OUTDOOR_LOCK_INDOOR_LOCK;
+		airlocks[airlock].deferredCount = 0;
+		airlocks[airlock].unlocked = 0;
+	}
+	unlockedCount = 0;
+}
+
+/* start the clock on the state the airlock just entered */
+static void armStateDeadline(ulong index)
+{
+	const struct Deadline *deadline = &deadlines[airlocks[index].state];
+
+	if(deadline->ms == 0)
+	{
+		cancelDeadline(index);
+	}
+	else
+	{
+		armDeadline(index, deadline->ms, deadline->event);
+	}
+}
+
+int restoreAirlock(ulong index, ulong state, unsigned int unlocked)
+{
+	struct Airlock *airlock = &airlocks[index];
+
+	if(state >= NUMBER_OF_STATES || unlocked != doorsUnlockedIn[state])
+	{
+		return 0;
+	}
+	airlock->state = restoredAs[state];
+	airlock->unlocked = unlocked;
+
+	if(state != OUTDOOR_LOCK_INDOOR_LOCK)
+	{
+		++unlockedCount;
+	}
+	armStateDeadline(index);
+	return 1;
+}
+
+/* never both doors unlocked, and only the ones the state says */
+static void checkDoors(ulong index)
+{
+	const struct Airlock *airlock = &airlocks[index];
+
+	if(airlock->unlocked == (DOOR_BIT(INNER_DOOR) | DOOR_BIT(OUTER_DOOR)) ||
+		airlock->unlocked != doorsUnlockedIn[airlock->state])
+	{
+		++violations;
+		logWrite("airlock %lu: doors %lu unlocked do not match the state", index, airlock->unlocked);
+	}
+}
+
+int handleEvent(const struct Event *event)
+{
+	const struct Transition *transition;
+	struct Airlock *airlock;
+	ulong previousState;
+
+	if(event->type >= NUMBER_OF_TRANSITIONS || event->airlock >= NUMBER_OF_AIRLOCKS)
+	{
+		return 0;
+	}
+	airlock = &airlocks[event->airlock];
+	transition = &stateMachine[airlock->state][event->type];
+	currentEvent = *event;
+
+	/* call the state transition action, then update the airlock's state */
+	transition->action(event->airlock, event->type);
+	if(transition->next == STAY || transition->next == airlock->state)
+	{
+		checkDoors(event->airlock);
+		return 0;
+	}
+
+	previousState = airlock->state;
+	airlock->state = transition->next;
+	if(previousState == OUTDOOR_LOCK_INDOOR_LOCK)
+	{
+		++unlockedCount;
+	}
+	else if(airlock->state == OUTDOOR_LOCK_INDOOR_LOCK)
+	{
+		--unlockedCount;
+	}
+	armStateDeadline(event->airlock);
+	checkDoors(event->airlock);
+	return 1;
+}
+
+/* handle the oldest event parked on the airlock that its new state no
+ * longer defers, and repeat since that may change the state again */
+void replayDeferred(ulong index)
+{
+	struct Airlock *airlock = &airlocks[index];
+	struct Event event;
+	int i, j;
+
+	for(i=0;i<airlock->deferredCount;)
+	{
+		if(stateMachine[airlock->state][airlock->deferred[i].type].action == waitingState)
+		{
+			++i;
+			continue;
+		}
+
+		event = airlock->deferred[i];
+		for(j=i+1;j<airlock->deferredCount;++j)
+		{
+			airlock->deferred[j-1] = airlock->deferred[j];
+		}
+		--airlock->deferredCount;
+
+		handleEvent(&event);
+		i = 0;
+	}
+}
+
+const char *doorStatus(ulong state, unsigned int unlocked, enum Door door)
+{
+	if((door == OUTER_DOOR && state == OUTDOOR_OPEN_INDOOR_LOCK) ||
+		(door == INNER_DOOR && state == OUTDOOR_LOCK_INDOOR_OPEN))
+	{
+		return "open";
+	}
+	return (unlocked & DOOR_BIT(door)) ? "unlocked" : "locked";
+}
+
+ulong airlockState(ulong airlock)
+{
+	return airlocks[airlock].state;
+}
+
+unsigned int unlockedDoors(ulong airlock)
+{
+	return airlocks[airlock].unlocked;
+}
+
+int unlockedAirlocks(void)
+{
+	return unlockedCount;
+}
+
+unsigned long invariantViolations(void)
+{
+	return violations;
+}
+
+unsigned long doorAlarms(void)
+{
+	return alarms;
+}
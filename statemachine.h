@@ -0,0 +1,51 @@
+#ifndef STATEMACHINE_H
+#define STATEMACHINE_H
+
+#include "controller.h"
+#include "event.h"
+
+enum Door { INNER_DOOR, OUTER_DOOR };
+
+/* bits of an airlock's unlocked doors */
+#define DOOR_BIT(door)			(1 << (door))
+
+/* every airlock locked, lights not yet set */
+void initStateMachine(void);
+
+/* put an airlock back in a state saved before a warm reset, arming the
+ * state's deadline again.  A door open state comes back as the matching
+ * unlocked state, and the sensors report the door open again if it still
+ * is.  Returns 0, leaving it locked, if the doors do not match the state */
+int restoreAirlock(ulong airlock, ulong state, unsigned int unlocked);
+
+/* run one event through its airlock's state machine, in constant time.
+ * Returns nonzero if the airlock changed state */
+int handleEvent(const struct Event *event);
+
+/* after a state change, handle the events parked on the airlock that its
+ * new state no longer defers */
+void replayDeferred(ulong airlock);
+
+ulong airlockState(ulong airlock);
+
+/* DOOR_BIT()s of the doors the state machine has unlocked */
+unsigned int unlockedDoors(ulong airlock);
+
+/* "locked", "unlocked" or "open", for display */
+const char *doorStatus(ulong state, unsigned int unlocked, enum Door door);
+
+/* airlocks with a door unlocked */
+int unlockedAirlocks(void);
+
+/* events after which an airlock had both doors unlocked, or door outputs
+ * that did not match its state.  Always 0 unless the table is wrong */
+unsigned long invariantViolations(void);
+
+/* doors held open past their deadline */
+unsigned long doorAlarms(void);
+
+/* supplied by the controller: switch one of an airlock's door lights (on
+ * is locked) on behalf of the event being handled */
+void setDoorLight(const struct Event *cause, ulong airlock, enum Door door, int on);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef STATICASSERT_H
+#define STATICASSERT_H
+
+/* compile-time check at file scope: a false cond does not compile, and the
+ * error names the array type name, which should say what must hold */
+#define STATIC_ASSERT(cond, name)	typedef char name[(cond) ? 1 : -1]
+
+#endif